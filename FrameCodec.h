@@ -0,0 +1,142 @@
+//
+//  FrameCodec.h
+//  Oasis X2 plugin
+//
+//  Encoder and decoder for the frames declared in protocol.h.
+//  Field offsets and sizes come from the PACK structs at compile time, integers are big endian on the wire.
+//  CFrameWriter builds a frame straight into a HID report, CFrameView reads fields in place from a received
+//  report after checking it against the length the device put in the frame header.
+
+#ifndef __FrameCodec__
+#define __FrameCodec__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "protocol.h"
+
+#define FRAME_MAX_LEN   64  // HID report payload, the report ID comes before it
+
+// the PACK structs must match the firmware byte for byte
+static_assert(sizeof(FrameHead) == 2, "FrameHead layout");
+static_assert(sizeof(FrameCommandAck) == 3, "FrameCommandAck layout");
+static_assert(sizeof(FrameProductModelAck) == 2 + FRAME_NAME_LEN, "FrameProductModelAck layout");
+static_assert(sizeof(FrameSerialNumber) == 2 + FRAME_NAME_LEN, "FrameSerialNumber layout");
+static_assert(sizeof(FrameVersionAck) == 38, "FrameVersionAck layout");
+static_assert(sizeof(FrameFriendlyName) == 2 + FRAME_NAME_LEN, "FrameFriendlyName layout");
+static_assert(sizeof(FrameBluetoothName) == 2 + FRAME_NAME_LEN, "FrameBluetoothName layout");
+static_assert(sizeof(FrameUserID) == 6, "FrameUserID layout");
+static_assert(sizeof(FrameOnOff) == 3, "FrameOnOff layout");
+static_assert(sizeof(FrameMove) == 7, "FrameMove layout");
+static_assert(sizeof(FrameMoveTo) == 6, "FrameMoveTo layout");
+static_assert(sizeof(FrameSyncPosition) == 6, "FrameSyncPosition layout");
+static_assert(sizeof(FrameConfig) == 20, "FrameConfig layout");
+static_assert(sizeof(FrameStatusAck) == 16, "FrameStatusAck layout");
+static_assert(sizeof(FrameUpgrade) == 41, "FrameUpgrade layout");
+static_assert(sizeof(FrameUpgradeAck) == 5, "FrameUpgradeAck layout");
+
+template <typename T>
+class CFrameWriter
+{
+    static_assert(sizeof(T) <= FRAME_MAX_LEN, "frame doesn't fit in a HID report");
+
+public:
+    typedef T FrameType;
+
+    // cReport is a whole HID report, report ID 0 then the frame. Everything past the header is cleared
+    // once here, the fields are then written in place.
+    CFrameWriter(unsigned char *cReport, unsigned char nCode) : m_pFrame(cReport + 1)
+    {
+        cReport[0] = 0;
+        m_pFrame[0] = nCode;
+        m_pFrame[1] = (unsigned char)(sizeof(T) - sizeof(FrameHead));
+        memset(m_pFrame + sizeof(FrameHead), 0, FRAME_MAX_LEN - sizeof(FrameHead));
+    }
+
+    template <typename F, size_t OFFSET, size_t SIZE>
+    void set(uint32_t nValue)
+    {
+        static_assert(std::is_same<F, T>::value, "field from another frame type");
+        static_assert(OFFSET >= sizeof(FrameHead) && OFFSET + SIZE <= sizeof(T), "field outside of the frame");
+        static_assert(SIZE == 1 || SIZE == 2 || SIZE == 4, "only 8, 16 and 32 bit fields");
+        for(size_t i = 0; i < SIZE; i++)
+            m_pFrame[OFFSET + i] = (unsigned char)(nValue >> (8 * (SIZE - 1 - i)));
+    }
+
+    // byte array fields, truncated to the field size. The rest of the field is already zero.
+    template <typename F, size_t OFFSET, size_t SIZE>
+    void setBytes(const void *pData, size_t nLen)
+    {
+        static_assert(std::is_same<F, T>::value, "field from another frame type");
+        static_assert(OFFSET >= sizeof(FrameHead) && OFFSET + SIZE <= sizeof(T), "field outside of the frame");
+        memcpy(m_pFrame + OFFSET, pData, nLen < SIZE ? nLen : SIZE);
+    }
+
+private:
+    unsigned char   *m_pFrame;
+};
+
+// MIN_LEN is the shortest frame we accept, it defaults to the whole struct.
+// Frames ending with a variable length field pass the offset of that field instead.
+template <typename T, size_t MIN_LEN = sizeof(T)>
+class CFrameView
+{
+    static_assert(MIN_LEN >= sizeof(FrameHead) && MIN_LEN <= sizeof(T), "bad minimum frame length");
+
+public:
+    typedef T FrameType;
+
+    // pFrame points at the frame code, nLength is the number of bytes that were read
+    CFrameView(const unsigned char *pFrame, int nLength) : m_pFrame(pFrame), m_nLen(0)
+    {
+        size_t nFrameLen;
+
+        if(nLength < (int)sizeof(FrameHead))
+            return;
+        nFrameLen = sizeof(FrameHead) + pFrame[1];
+        if(nFrameLen > (size_t)nLength || nFrameLen < MIN_LEN)
+            return; // the header claims more than we got, or not enough for the fixed fields
+        m_nLen = nFrameLen;
+    }
+
+    bool valid() const { return m_nLen != 0; }
+
+    // fixed fields, only call these on a valid view
+    template <typename F, size_t OFFSET, size_t SIZE>
+    uint32_t get() const
+    {
+        uint32_t nValue = 0;
+
+        static_assert(std::is_same<F, T>::value, "field from another frame type");
+        static_assert(OFFSET >= sizeof(FrameHead) && OFFSET + SIZE <= MIN_LEN, "field isn't always present");
+        static_assert(SIZE == 1 || SIZE == 2 || SIZE == 4, "only 8, 16 and 32 bit fields");
+        for(size_t i = 0; i < SIZE; i++)
+            nValue = (nValue << 8) | m_pFrame[OFFSET + i];
+        return nValue;
+    }
+
+    // byte array fields, nLen is bounded by the field size and by the frame length the device declared
+    template <typename F, size_t OFFSET, size_t SIZE>
+    const char *bytes(size_t &nLen) const
+    {
+        static_assert(std::is_same<F, T>::value, "field from another frame type");
+        static_assert(OFFSET >= sizeof(FrameHead) && OFFSET + SIZE <= sizeof(T), "field outside of the frame");
+        nLen = m_nLen > OFFSET ? m_nLen - OFFSET : 0;
+        if(nLen > SIZE)
+            nLen = SIZE;
+        return (const char *)(m_pFrame + OFFSET);
+    }
+
+private:
+    const unsigned char *m_pFrame;
+    size_t              m_nLen;
+};
+
+#define FrameSet(writer, type, field, value)            (writer).set<type, offsetof(type, field), sizeof(type::field)>(value)
+#define FrameSetBytes(writer, type, field, data, len)   (writer).setBytes<type, offsetof(type, field), sizeof(type::field)>(data, len)
+#define FrameGet(view, type, field)                     (view).get<type, offsetof(type, field), sizeof(type::field)>()
+#define FrameBytes(view, type, field, len)              (view).bytes<type, offsetof(type, field), sizeof(type::field)>(len)
+
+#endif /* __FrameCodec__ */
@@ -0,0 +1,179 @@
+//
+//  FrameTrace.cpp
+//  Oasis X2 plugin
+//
+//  Binary HID report trace, see FrameTrace.h
+
+#include <cstring>
+#include <chrono>
+
+#ifdef SB_WIN_BUILD
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "FrameTrace.h"
+
+static int64_t steadyTimeUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CFrameTrace::CFrameTrace()
+{
+    m_pMap = nullptr;
+    m_nMapSize = 0;
+#ifdef SB_WIN_BUILD
+    m_hFile = INVALID_HANDLE_VALUE;
+    m_hMapping = nullptr;
+#else
+    m_nFd = -1;
+#endif
+    m_pHeader = nullptr;
+    m_pRecords = nullptr;
+    m_nCapacity = 0;
+    m_nStartSteadyUs = 0;
+    m_nNext = 0;
+}
+
+CFrameTrace::~CFrameTrace()
+{
+    close();
+}
+
+bool CFrameTrace::open(const std::string &sPath, uint32_t nRecords)
+{
+    close();
+
+    if(!nRecords)
+        return false;
+
+    if(!mapFile(sPath, sizeof(TraceHeader) + (size_t)nRecords * sizeof(TraceRecord)))
+        return false;
+
+    // the file is new so the records are all zero, nSeq 0 marks them as never written
+    m_pHeader = (TraceHeader *)m_pMap;
+    memcpy(m_pHeader->szMagic, TRACE_MAGIC, sizeof(m_pHeader->szMagic));
+    m_pHeader->nRecordSize = sizeof(TraceRecord);
+    m_pHeader->nCapacity = nRecords;
+    m_pHeader->nStartTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    m_pHeader->nWritten = 0;
+
+    m_nCapacity = nRecords;
+    m_nStartSteadyUs = steadyTimeUs();
+    m_nNext = 0;
+    m_pRecords = (TraceRecord *)((char *)m_pMap + sizeof(TraceHeader));
+    return true;
+}
+
+void CFrameTrace::close()
+{
+    m_pRecords = nullptr;
+    m_pHeader = nullptr;
+    unmapFile();
+}
+
+void CFrameTrace::record(int nDirection, const unsigned char *pReport, int nLength)
+{
+    TraceRecord *pRecord;
+    uint64_t nIndex;
+
+    if(!m_pRecords || nLength <= 0)
+        return;
+    if(nLength > TRACE_REPORT_LEN)
+        nLength = TRACE_REPORT_LEN;
+
+    nIndex = m_nNext.fetch_add(1, std::memory_order_relaxed);
+    pRecord = m_pRecords + (nIndex % m_nCapacity);
+    pRecord->nTimeUs = (uint64_t)(steadyTimeUs() - m_nStartSteadyUs);
+    pRecord->nDirection = (uint8_t)nDirection;
+    pRecord->nLength = (uint8_t)nLength;
+    memcpy(pRecord->cReport, pReport, nLength);
+    memset(pRecord->cReport + nLength, 0, TRACE_REPORT_LEN - nLength);
+    pRecord->nSeq = (uint32_t)(nIndex + 1);
+    m_pHeader->nWritten = nIndex + 1;
+}
+
+#pragma mark file mapping
+
+#ifdef SB_WIN_BUILD
+bool CFrameTrace::mapFile(const std::string &sPath, size_t nSize)
+{
+    m_hFile = CreateFileA(sPath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(m_hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READWRITE, (DWORD)((uint64_t)nSize >> 32), (DWORD)(nSize & 0xFFFFFFFF), NULL);
+    if(!m_hMapping) {
+        unmapFile();
+        return false;
+    }
+
+    m_pMap = MapViewOfFile(m_hMapping, FILE_MAP_WRITE, 0, 0, nSize);
+    if(!m_pMap) {
+        unmapFile();
+        return false;
+    }
+    m_nMapSize = nSize;
+    return true;
+}
+
+void CFrameTrace::unmapFile()
+{
+    if(m_pMap) {
+        FlushViewOfFile(m_pMap, 0);
+        UnmapViewOfFile(m_pMap);
+        m_pMap = nullptr;
+    }
+    if(m_hMapping) {
+        CloseHandle(m_hMapping);
+        m_hMapping = nullptr;
+    }
+    if(m_hFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_hFile);
+        m_hFile = INVALID_HANDLE_VALUE;
+    }
+    m_nMapSize = 0;
+}
+#else
+bool CFrameTrace::mapFile(const std::string &sPath, size_t nSize)
+{
+    void *pMap;
+
+    m_nFd = ::open(sPath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(m_nFd < 0)
+        return false;
+
+    if(ftruncate(m_nFd, (off_t)nSize) < 0) {
+        unmapFile();
+        return false;
+    }
+
+    pMap = mmap(nullptr, nSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_nFd, 0);
+    if(pMap == MAP_FAILED) {
+        unmapFile();
+        return false;
+    }
+    m_pMap = pMap;
+    m_nMapSize = nSize;
+    return true;
+}
+
+void CFrameTrace::unmapFile()
+{
+    if(m_pMap) {
+        msync(m_pMap, m_nMapSize, MS_ASYNC);
+        munmap(m_pMap, m_nMapSize);
+        m_pMap = nullptr;
+    }
+    if(m_nFd >= 0) {
+        ::close(m_nFd);
+        m_nFd = -1;
+    }
+    m_nMapSize = 0;
+}
+#endif
@@ -0,0 +1,78 @@
+//
+//  FrameTrace.h
+//  Oasis X2 plugin
+//
+//  Binary trace of the HID reports exchanged with the focuser.
+//  The file is a fixed size header followed by a ring of fixed size records, it's memory mapped so a record
+//  costs a copy into the mapping and the kernel writes it out, even if TheSkyX dies afterward.
+//  Once the ring is full the oldest records are overwritten. OasisReplay reads it back offline.
+
+#ifndef __FrameTrace__
+#define __FrameTrace__
+
+#include <atomic>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+#define TRACE_MAGIC         "OASTRC01"
+#define TRACE_REPORT_LEN    65      // a whole HID report, report ID included for writes
+#define TRACE_RECORDS       65536   // records in the ring, 5MB
+
+enum TraceDirections    {TRACE_TX = 0, TRACE_RX};
+
+typedef struct _TraceHeader {
+    char        szMagic[8];
+    uint32_t    nRecordSize;
+    uint32_t    nCapacity;
+    int64_t     nStartTimeUs;   // wall clock when the trace was opened, the records are relative to it
+    uint64_t    nWritten;       // records written since then, informational, the records carry their own sequence
+    uint8_t     cReserved[32];
+} TraceHeader;
+
+typedef struct _TraceRecord {
+    uint64_t    nTimeUs;        // monotonic, microseconds since the trace was opened
+    uint32_t    nSeq;           // 1 for the first record, 0 for a slot that was never written
+    uint8_t     nDirection;
+    uint8_t     nLength;        // valid bytes in cReport
+    uint8_t     cReport[TRACE_REPORT_LEN];
+    uint8_t     cReserved[1];
+} TraceRecord;
+
+static_assert(sizeof(TraceHeader) == 64, "TraceHeader layout");
+static_assert(sizeof(TraceRecord) == 80, "TraceRecord layout");
+
+class CFrameTrace
+{
+public:
+    CFrameTrace();
+    ~CFrameTrace();
+
+    // creates (truncates) the file. Open and close while nothing is recording.
+    bool        open(const std::string &sPath, uint32_t nRecords = TRACE_RECORDS);
+    void        close();
+    bool        isOpen() const      { return m_pRecords != nullptr; }
+
+    // safe from any thread
+    void        record(int nDirection, const unsigned char *pReport, int nLength);
+
+protected:
+    bool        mapFile(const std::string &sPath, size_t nSize);
+    void        unmapFile();
+
+    void                    *m_pMap;
+    size_t                  m_nMapSize;
+#ifdef SB_WIN_BUILD
+    void                    *m_hFile;
+    void                    *m_hMapping;
+#else
+    int                     m_nFd;
+#endif
+    TraceHeader             *m_pHeader;
+    TraceRecord             *m_pRecords;
+    uint32_t                m_nCapacity;
+    int64_t                 m_nStartSteadyUs;
+    std::atomic<uint64_t>   m_nNext;
+};
+
+#endif /* __FrameTrace__ */
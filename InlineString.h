@@ -0,0 +1,74 @@
+//
+//  InlineString.h
+//  Oasis X2 plugin
+//
+//  Fixed capacity string stored inline, it never allocates.
+//  Used for the names and versions the focuser sends, they're bounded by the frame size anyway.
+//  Anything longer than the capacity is truncated. It's trivially copyable so it can go through CSeqLock.
+
+#ifndef __InlineString__
+#define __InlineString__
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <ostream>
+
+template <size_t N>
+class CInlineString
+{
+public:
+    CInlineString() { clear(); }
+
+    void clear()
+    {
+        m_nLen = 0;
+        m_szBuffer[0] = 0;
+    }
+
+    // copy up to nMaxLen characters or the first NUL, frame fields aren't always terminated
+    void assign(const char *szSrc, size_t nMaxLen)
+    {
+        size_t nLen = 0;
+
+        if(nMaxLen > N)
+            nMaxLen = N;
+        while(nLen < nMaxLen && szSrc[nLen])
+            nLen++;
+        memcpy(m_szBuffer, szSrc, nLen);
+        m_szBuffer[nLen] = 0;
+        m_nLen = nLen;
+    }
+
+    void assign(const char *szSrc)          { assign(szSrc, N); }
+    void assign(const std::string &sSrc)    { assign(sSrc.c_str(), sSrc.size()); }
+
+    // for formatted values, the result is truncated to the capacity like assign()
+    char *buffer()                          { return m_szBuffer; }
+    void update()                           { m_szBuffer[N] = 0; m_nLen = strlen(m_szBuffer); }
+
+    const char *c_str() const               { return m_szBuffer; }
+    size_t size() const                     { return m_nLen; }
+    bool empty() const                      { return m_nLen == 0; }
+    static size_t capacity()                { return N; }
+
+    bool operator==(const char *szOther) const          { return strcmp(m_szBuffer, szOther) == 0; }
+    bool operator==(const std::string &sOther) const    { return m_nLen == sOther.size() && memcmp(m_szBuffer, sOther.c_str(), m_nLen) == 0; }
+    bool operator!=(const char *szOther) const          { return !(*this == szOther); }
+    bool operator!=(const std::string &sOther) const    { return !(*this == sOther); }
+
+private:
+    size_t  m_nLen;
+    char    m_szBuffer[N+1];
+};
+
+template <size_t N>
+bool operator==(const std::string &sLeft, const CInlineString<N> &sRight) { return sRight == sLeft; }
+
+template <size_t N>
+bool operator!=(const std::string &sLeft, const CInlineString<N> &sRight) { return sRight != sLeft; }
+
+template <size_t N>
+std::ostream &operator<<(std::ostream &os, const CInlineString<N> &sValue) { return os << sValue.c_str(); }
+
+#endif /* __InlineString__ */
@@ -0,0 +1,81 @@
+//
+//  MpscQueue.h
+//  Oasis X2 plugin
+//
+//  Bounded lock-free multi-producer / single-consumer queue.
+//  Every slot carries a sequence number telling producers and the consumer whose turn it is,
+//  so push() only needs one CAS on the tail and pop() none at all.
+//  push() fails instead of blocking when the queue is full, pop() must only be called by one thread at a time.
+
+#ifndef __MpscQueue__
+#define __MpscQueue__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+template <typename T, size_t N>
+class CMpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "CMpscQueue size must be a power of 2");
+
+public:
+    CMpscQueue()
+    {
+        for(size_t i = 0; i < N; i++)
+            m_Slots[i].nSeq.store(i, std::memory_order_relaxed);
+        m_nTail.store(0, std::memory_order_relaxed);
+        m_nHead.store(0, std::memory_order_relaxed);
+    }
+
+    bool push(const T &item)
+    {
+        size_t nPos = m_nTail.load(std::memory_order_relaxed);
+        for(;;) {
+            Slot &slot = m_Slots[nPos & (N - 1)];
+            size_t nSeq = slot.nSeq.load(std::memory_order_acquire);
+            intptr_t nDiff = (intptr_t)nSeq - (intptr_t)nPos;
+            if(nDiff == 0) {
+                // the slot is free for this position, claim it
+                if(m_nTail.compare_exchange_weak(nPos, nPos + 1, std::memory_order_relaxed)) {
+                    slot.item = item;
+                    slot.nSeq.store(nPos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if(nDiff < 0) {
+                return false; // full, the consumer hasn't freed this slot yet
+            }
+            else {
+                nPos = m_nTail.load(std::memory_order_relaxed); // another producer got it first
+            }
+        }
+    }
+
+    bool pop(T &item)
+    {
+        size_t nPos = m_nHead.load(std::memory_order_relaxed);
+        Slot &slot = m_Slots[nPos & (N - 1)];
+        size_t nSeq = slot.nSeq.load(std::memory_order_acquire);
+
+        if((intptr_t)nSeq - (intptr_t)(nPos + 1) < 0)
+            return false; // empty, or the producer of this slot is still copying its item
+        item = slot.item;
+        slot.nSeq.store(nPos + N, std::memory_order_release); // free the slot for the next lap
+        m_nHead.store(nPos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<size_t> nSeq;
+        T                   item;
+    };
+
+    Slot                            m_Slots[N];
+    // keep the producer and consumer indexes on their own cache lines
+    alignas(64) std::atomic<size_t> m_nTail;
+    alignas(64) std::atomic<size_t> m_nHead;
+};
+
+#endif /* __MpscQueue__ */
@@ -7,64 +7,295 @@
 
 #include "Oasis.h"
 
-void threaded_sender(std::future<void> futureObj, COasisController *OasisControllerObj, hid_device *hidDevice)
-{
-    const byte cmdData[REPORT_SIZE] = {0x00, CODE_GET_STATUS, 0x00};
-    int nByteWriten = 0;
-    while (futureObj.wait_for(std::chrono::milliseconds(1000)) == std::future_status::timeout) {
-        if(hidDevice && OasisControllerObj && OasisControllerObj->m_DevAccessMutex.try_lock()) {
-            nByteWriten = hid_write(hidDevice, cmdData, sizeof(cmdData));
-            OasisControllerObj->m_DevAccessMutex.unlock();
-            if(nByteWriten == -1)  { // error
-                std::this_thread::yield();
-                continue;
-            }
+void threaded_io(COasisController *OasisControllerObj)
+{
+    byte cHIDBuffer[REPORT_SIZE];
+    int nbRead;
+    int nBatch;
+
+    if(!OasisControllerObj)
+        return;
+
+    while (!OasisControllerObj->m_bStopIO) {
+        // this thread is the only one touching the device, writes go first and a halt before anything else.
+        OasisControllerObj->flushCommands();
+
+        if(OasisControllerObj->isLinkStalled()) {
+            OasisControllerObj->reopenDevice();
+            continue;
         }
-        else {
-            std::this_thread::yield();
+        OasisControllerObj->pollStatus();
+
+        // sleep until the device has a report for us, a command is queued or the next status is due.
+        nbRead = OasisControllerObj->devRead(cHIDBuffer, REPORT_SIZE, OasisControllerObj->nextIOTimeout());
+        if(nbRead < 0) { // device error, the watchdog reopens it on the next round, don't spin on it meanwhile.
+            OasisControllerObj->signalLinkError();
+            OasisControllerObj->waitIOBackoff(READER_ERROR_BACKOFF);
+            continue;
+        }
+        if(nbRead == 0) // timeout or wake up
+            continue;
+
+        // hand everything that is already pending to the parser so the device queue never backs up.
+        OasisControllerObj->queueReport(cHIDBuffer, nbRead);
+        for(nBatch = 1; nBatch < READ_BATCH_SIZE; nBatch++) {
+            nbRead = OasisControllerObj->devRead(cHIDBuffer, REPORT_SIZE, 0);
+            if(nbRead <= 0)
+                break;
+            OasisControllerObj->queueReport(cHIDBuffer, nbRead);
         }
     }
 }
 
-void threaded_poller(std::future<void> futureObj, COasisController *OasisControllerObj, hid_device *hidDevice)
+void threaded_parser(COasisController *OasisControllerObj)
 {
-    int nbRead;
-    byte cHIDBuffer[REPORT_SIZE];
+    if(!OasisControllerObj)
+        return;
 
-    while (futureObj.wait_for(std::chrono::milliseconds(1)) == std::future_status::timeout) {
-        if(hidDevice && OasisControllerObj && OasisControllerObj->m_DevAccessMutex.try_lock()) {
-            nbRead = hid_read(hidDevice, cHIDBuffer, sizeof(cHIDBuffer));
-            OasisControllerObj->m_DevAccessMutex.unlock();
-            if(nbRead>0){
-                OasisControllerObj->parseResponse(cHIDBuffer, nbRead);
-            }
-            else {
-                std::this_thread::yield();
-            }
+    while (!OasisControllerObj->m_bStopParser) {
+        OasisControllerObj->parseReports();
+        OasisControllerObj->checkRestore();
+        OasisControllerObj->waitForReports();
+    }
+}
+
+#pragma mark - HID runtime
+
+// hid_init/hid_exit are process wide, tearing the runtime down under another instance breaks its link.
+// A controller takes a reference when it first enumerates or connects and drops it on Disconnect, the last one out calls hid_exit.
+static std::mutex                   g_HidMutex;
+static int                          g_nHidUsers = 0;
+
+static void acquireHidRuntime()
+{
+    const std::lock_guard<std::mutex> lock(g_HidMutex);
+    if(g_nHidUsers++ == 0)
+        hid_init();
+}
+
+static void releaseHidRuntime()
+{
+    const std::lock_guard<std::mutex> lock(g_HidMutex);
+    if(g_nHidUsers && --g_nHidUsers == 0)
+        hid_exit();
+}
+
+#pragma mark - device enumeration cache
+
+// process wide list of the focusers on the bus, shared by all the controller instances.
+// On Linux a udev monitor keeps it current while a focuser is connected, otherwise it's refreshed once older than ENUM_CACHE_TTL.
+static std::mutex                   g_EnumMutex;
+static std::vector<std::string>     g_EnumSerials;
+static bool                         g_bEnumValid = false;
+static CStopWatch                   g_EnumTimer;
+
+static std::mutex                   g_HotplugMutex; // protects the monitor start/stop and user count
+static int                          g_nHotplugUsers = 0;
+static std::atomic<bool>            g_bHotplugRunning(false);
+#ifdef SB_LINUX_BUILD
+static std::thread                  g_HotplugThread;
+static std::atomic<bool>            g_bStopHotplug(false);
+static int                          g_nHotplugWakeFd = -1;
+static struct udev                  *g_pUdev = nullptr;
+static struct udev_monitor          *g_pUdevMonitor = nullptr;
+#endif
+
+static void enumerateFocusers(std::vector<std::string> &focuserSNList)
+{
+    hid_device_info *deviceInfoList, *curDev;
+    std::wstring ws;
+
+    focuserSNList.clear();
+    deviceInfoList = hid_enumerate(VENDOR_ID, PRODUCT_ID);
+    for (curDev = deviceInfoList; curDev != nullptr; curDev = curDev->next) {
+        if(!curDev->serial_number)
+            continue;
+        ws.assign(curDev->serial_number);
+        focuserSNList.push_back(std::string(ws.begin(), ws.end()));
+    }
+    hid_free_enumeration(deviceInfoList);
+}
+
+static void refreshFocuserList()
+{
+    std::vector<std::string> focuserSNList;
+
+    // enumerate outside of the lock, readers keep getting the previous list meanwhile.
+    enumerateFocusers(focuserSNList);
+
+    const std::lock_guard<std::mutex> lock(g_EnumMutex);
+    g_EnumSerials.swap(focuserSNList);
+    g_bEnumValid = true;
+    g_EnumTimer.Reset();
+}
+
+#ifdef SB_LINUX_BUILD
+void threaded_hotplug(struct udev_monitor *monitor)
+{
+    struct pollfd fds[2];
+    struct udev_device *dev;
+    const char *szAction;
+    bool bChanged;
+
+    fds[0].fd = udev_monitor_get_fd(monitor);
+    fds[0].events = POLLIN;
+    fds[1].fd = g_nHotplugWakeFd;
+    fds[1].events = POLLIN;
+
+    while(!g_bStopHotplug) {
+        if(poll(fds, 2, -1) < 0) {
+            if(errno == EINTR)
+                continue;
+            break;
         }
-        else {
-            std::this_thread::yield();
+        if(g_bStopHotplug)
+            break;
+        if(!(fds[0].revents & POLLIN))
+            continue;
+
+        // a plug generates a burst of events, drain them all and enumerate once.
+        bChanged = false;
+        while((dev = udev_monitor_receive_device(monitor)) != nullptr) {
+            szAction = udev_device_get_action(dev);
+            if(szAction && (!strcmp(szAction, "add") || !strcmp(szAction, "remove")))
+                bChanged = true;
+            udev_device_unref(dev);
         }
+        if(bChanged)
+            refreshFocuserList();
     }
+    g_bHotplugRunning = false;
 }
+#endif
+
+static void startHotplugMonitor()
+{
+    const std::lock_guard<std::mutex> lock(g_HotplugMutex);
+    if(g_nHotplugUsers++)
+        return;
+#ifdef SB_LINUX_BUILD
+    g_pUdev = udev_new();
+    if(!g_pUdev)
+        return;
+    g_pUdevMonitor = udev_monitor_new_from_netlink(g_pUdev, "udev");
+    if(!g_pUdevMonitor) {
+        udev_unref(g_pUdev);
+        g_pUdev = nullptr;
+        return;
+    }
+    udev_monitor_filter_add_match_subsystem_devtype(g_pUdevMonitor, "hidraw", nullptr);
+    g_nHotplugWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(udev_monitor_enable_receiving(g_pUdevMonitor) < 0 || g_nHotplugWakeFd < 0) {
+        if(g_nHotplugWakeFd >= 0)
+            close(g_nHotplugWakeFd);
+        g_nHotplugWakeFd = -1;
+        udev_monitor_unref(g_pUdevMonitor);
+        g_pUdevMonitor = nullptr;
+        udev_unref(g_pUdev);
+        g_pUdev = nullptr;
+        return;
+    }
+    // the list is only trusted once the monitor is listening, anything plugged before that is in the first enumeration.
+    g_bStopHotplug = false;
+    g_bHotplugRunning = true;
+    g_HotplugThread = std::thread(&threaded_hotplug, g_pUdevMonitor);
+    COasisController::invalidateFocuserList();
+#endif
+}
+
+static void stopHotplugMonitor()
+{
+    const std::lock_guard<std::mutex> lock(g_HotplugMutex);
+    if(!g_nHotplugUsers || --g_nHotplugUsers)
+        return;
+#ifdef SB_LINUX_BUILD
+    if(g_HotplugThread.joinable()) {
+        uint64_t nOne = 1;
+        g_bStopHotplug = true;
+        if(write(g_nHotplugWakeFd, &nOne, sizeof(nOne)) < 0) {
+            // nothing we can do, the thread still checks g_bStopHotplug on the next event.
+        }
+        g_HotplugThread.join();
+    }
+    g_bHotplugRunning = false;
+    if(g_nHotplugWakeFd >= 0)
+        close(g_nHotplugWakeFd);
+    g_nHotplugWakeFd = -1;
+    if(g_pUdevMonitor)
+        udev_monitor_unref(g_pUdevMonitor);
+    g_pUdevMonitor = nullptr;
+    if(g_pUdev)
+        udev_unref(g_pUdev);
+    g_pUdev = nullptr;
+#endif
+}
+
+void COasisController::invalidateFocuserList()
+{
+    const std::lock_guard<std::mutex> lock(g_EnumMutex);
+    g_bEnumValid = false;
+}
+
+#pragma mark - COasisController
 
 COasisController::COasisController()
+    : m_HidapiTransport(m_Logger),
+#ifdef SB_LINUX_BUILD
+      m_HidrawTransport(m_Logger),
+#endif
+      m_Simulator(m_Logger),
+      m_FaultTransport(m_Logger)
 {
     m_bDebugLog = false;
     m_bIsConnected = false;
     m_Oasis_Settings.nCurPos = 0;
     m_nTargetPos = 0;
     m_nTempSource = INTERNAL;
-    m_DevHandle = nullptr;
+    m_pTransport = &m_HidapiTransport;
+    m_bFaultInjection = false;
+#ifdef SB_LINUX_BUILD
+    m_nTransport = TRANSPORT_HIDRAW;
+#else
+    m_nTransport = TRANSPORT_HIDAPI;
+#endif
+    m_nActiveTransport = TRANSPORT_HIDAPI;
     m_Oasis_Settings.fInternal = -100.0;
     m_Oasis_Settings.fAmbient = -100.0;
     m_bSetUserConf = false;
     
     m_ThreadsAreRunning = false;
+    m_bStopIO = false;
+    m_bStopParser = false;
+    m_bParserIdle = false;
+    for(int i = 0; i < FRAME_CODES; i++) {
+        m_FrameHandlers[i].pHandler = DefaultFrameHandlers[i];
+        m_FrameHandlers[i].pContext = DefaultFrameHandlers[i] ? this : nullptr;
+    }
+    m_nRingHighWater = 0;
+    m_nRingOverflows = 0;
+    m_nRingOverflowsLogged = 0;
+    m_bDeviceOpen = false;
+    m_bHaveRetryCmd = false;
+    m_bHaltRequested = false;
+    m_nHaltRequestTime = 0;
+    m_nHaltLatency = 0;
+    m_nHaltLatencyMax = 0;
     m_nGotoTries = 0;
+    m_bGotoPending = false;
+    m_bStatusPending = false;
+    m_bStatusRefresh = false;
+    m_nStatusInterval = STATUS_POLL_IDLE_MIN;
+    m_bLinkError = false;
+    m_bRestorePending = false;
+    m_bNeedReconnect = false;
+    m_bCheckPosition = false;
+    m_nPosBeforeReconnect = 0;
+    m_nStallTimeout = LINK_STALL_TIMEOUT;
 
     m_sSerialNumber.clear();
-    m_DevHandle = nullptr;
+    m_bHidUser = false;
+    m_bHotplugUser = false;
+    m_bFrameTrace = false;
 
     m_Oasis_Settings.nCurPos = 0;
     m_Oasis_Settings.nMaxPos = 0;
@@ -89,34 +320,43 @@ COasisController::COasisController()
 
 
     m_bGotconfig = false;
+    m_bGotStatus = false;
+    m_bLiveVersion = false;
+    m_bLiveConfig = false;
+    m_bHaveDeviceCache = false;
     m_bGotBluetoothName = false;
     m_bGotFriendlyName = false;
     m_bGotModel = false;
     m_bGotVersion = false;
-    
-#ifdef PLUGIN_DEBUG
+    publishState();
+
+    memset(m_nReplySeq, 0, sizeof(m_nReplySeq));
+
 #if defined(SB_WIN_BUILD)
     m_sLogfilePath = getenv("HOMEDRIVE");
     m_sLogfilePath += getenv("HOMEPATH");
     m_sLogfilePath += "\\Oasis-Log.txt";
+    m_sTraceFolder = getenv("HOMEDRIVE");
+    m_sTraceFolder += getenv("HOMEPATH");
+    m_sTraceFolder += "\\";
     m_sPlatform = "Windows";
 #elif defined(SB_LINUX_BUILD)
     m_sLogfilePath = getenv("HOME");
     m_sLogfilePath += "/Oasis-Log.txt";
+    m_sTraceFolder = getenv("HOME");
+    m_sTraceFolder += "/";
     m_sPlatform = "Linux";
 #elif defined(SB_MAC_BUILD)
     m_sLogfilePath = getenv("HOME");
     m_sLogfilePath += "/Oasis-Log.txt";
+    m_sTraceFolder = getenv("HOME");
+    m_sTraceFolder += "/";
     m_sPlatform = "macOS";
 #endif
-    m_sLogFile.open(m_sLogfilePath, std::ios::out |std::ios::trunc);
-#endif
-
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 2
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [COasisController] Version " << std::fixed << std::setprecision(2) << PLUGIN_VERSION << " build " << __DATE__ << " " << __TIME__ << " on "<< m_sPlatform << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [COasisController] Constructor Called." << std::endl;
-    m_sLogFile.flush();
-#endif
+    // nothing is written until the focuser sets a level, see setLogLevel
+    m_Logger.setLogFile(m_sLogfilePath);
+    m_Logger.setLevel(LOG_DEFAULT_LEVEL);
+    logBanner();
 }
 
 COasisController::~COasisController()
@@ -125,269 +365,322 @@ COasisController::~COasisController()
     if(m_bIsConnected)
         Disconnect();
 
-#ifdef	PLUGIN_DEBUG
-    // Close LogFile
-    if(m_sLogFile.is_open())
-        m_sLogFile.close();
-#endif
+    detachHidRuntime();
 
 }
 
 int COasisController::Connect()
 {
     int nErr = PLUGIN_OK;
-    int nTimeout;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Called." << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] m_sSerialNumber : " << m_sSerialNumber << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "Connect", "Called.");
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "Connect", "m_sSerialNumber : %s", m_sSerialNumber.c_str());
     // vendor id is : 0x20E1 and the product id is : 0x0002.
     if(!m_sSerialNumber.size()) {
         std::vector<std::string> focuserSNList;
         listFocusers(focuserSNList);
-        if(focuserSNList.size()) {
+        if(focuserSNList.size())
             m_sSerialNumber.assign(focuserSNList.at(0));
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] opening device with serial " <<  m_sSerialNumber << " for vendor id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex <<  VENDOR_ID << " product id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << PRODUCT_ID << std::dec << std::endl;
-            m_sLogFile.flush();
-#endif
-            std::wstring widestr = std::wstring(m_sSerialNumber.begin(), m_sSerialNumber.end());
-            const wchar_t* widecstr = widestr.c_str();
-            m_DevHandle = hid_open(VENDOR_ID, PRODUCT_ID, widecstr);
-        }
-        else {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] opening first available device for vendor id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex <<  VENDOR_ID << " product id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << PRODUCT_ID << std::dec << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_DevHandle = hid_open(VENDOR_ID, PRODUCT_ID, NULL);
-        }
-
-    }
-    else {
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] opening device with serial " <<  m_sSerialNumber << " for vendor id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex <<  VENDOR_ID << " product id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << PRODUCT_ID << std::dec << std::endl;
-        m_sLogFile.flush();
-#endif
-        std::wstring widestr = std::wstring(m_sSerialNumber.begin(), m_sSerialNumber.end());
-        const wchar_t* widecstr = widestr.c_str();
-        m_DevHandle = hid_open(VENDOR_ID, PRODUCT_ID, widecstr);
     }
-    if (!m_DevHandle) {
+
+    m_bGotconfig = false;
+    m_bGotStatus = false;
+    m_bGotBluetoothName = false;
+    m_bGotFriendlyName = false;
+    m_bGotModel = false;
+    m_bGotVersion = false;
+    m_bLiveVersion = false;
+    m_bLiveConfig = false;
+    m_bLinkError = false;
+    m_bNeedReconnect = false;
+
+    if(m_nTransport != TRANSPORT_SIMULATOR)
+        attachHidRuntime();
+    nErr = devOpen();
+    if (nErr) {
+        invalidateFocuserList(); // the device might be gone, don't trust the cached list anymore
         m_bIsConnected = false;
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] hid_open failed for vendor id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex <<  VENDOR_ID << " product id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << PRODUCT_ID << std::dec << std::endl;
-        m_sLogFile.flush();
-#endif
-        m_DevHandle = nullptr;
         return Oasis_CANT_CONNECT;
     }
     m_bIsConnected = true;
+    // devOpen filled in the serial, the trace file is named after it. Before the I/O thread, it records without a lock.
+    if(m_bFrameTrace)
+        openFrameTrace();
+
+    // the udev monitor only runs while a focuser is connected, until then listFocusers goes by ENUM_CACHE_TTL.
+    if(m_nTransport != TRANSPORT_SIMULATOR && !m_bHotplugUser) {
+        startHotplugMonitor();
+        m_bHotplugUser = true;
+    }
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] Connected to vendor id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex <<  VENDOR_ID << " product id " << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << PRODUCT_ID << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "Connect", "Connected to vendor id %04X product id %04X", (unsigned int)VENDOR_ID, (unsigned int)PRODUCT_ID);
+
+    // warm link : start from the values cached for this serial, they are checked in the background below.
+    if(m_bHaveDeviceCache) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "Connect", "using cached device info, firmware %s", m_DeviceCache.sVersion.c_str());
+        applyDeviceCache();
+    }
 
-    // Set the hid_read() function to be non-blocking.
-    hid_set_nonblocking(m_DevHandle, 1);
     startThreads();
-    nTimeout = 0;
-    while(!m_bGotconfig) {
-        getConfig();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::this_thread::yield();
-        nTimeout++;
-        if(nTimeout>MAX_TIMEOUT) {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] timeout getting config" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-        }
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] waiting for config" << std::endl;
-        m_sLogFile.flush();
-#endif
+    // only wait for what motion needs, config for nMaxPos and the first status for the position.
+    const byte cEssential[] = {CODE_GET_CONFIG, CODE_GET_STATUS};
+    nErr = queryDeviceInfo(cEssential, sizeof(cEssential), CONNECT_TIMEOUT);
+    if(nErr) {
+        // the device opened but doesn't answer, don't report a link we can't move with.
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "Connect", "no config or status from the focuser, giving up.");
+        Disconnect();
+        return Oasis_CANT_CONNECT;
     }
+    // the rest is only shown in the dialogs, it will be there by the time anyone looks at it.
+    requestDeviceMetadata();
 
-    nTimeout = 0;
-    while(!m_bGotVersion){
-        getVersions();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::this_thread::yield();
-        nTimeout++;
-        if(nTimeout>MAX_TIMEOUT) {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] timeout getting version" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    if(m_Oasis_Settings.bExternalSensorPresent)
+        setTemperatureSource(EXTERNAL);
+
+    return nErr;
+}
+
+int COasisController::queryDeviceInfo(const byte *cQueries, int nQueries, int nTimeoutMs)
+{
+    int nErr = PLUGIN_OK;
+    CommandToken token;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point resendAt;
+    bool bDone = false;
+    int i;
+
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(nTimeoutMs);
+
+    while(!bDone) {
+        // send everything we're still missing back to back, parseResponse sets the m_bGot* flags as the replies come in.
+        for(i = 0; i < nQueries; i++) {
+            if(*gotFlag(cQueries[i]))
+                continue;
+            if(cQueries[i] == CODE_GET_STATUS)
+                requestStatusRefresh(); // the sender owns the status requests
+            else
+                sendQuery(cQueries[i], token);
         }
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] waiting for version" << std::endl;
-        m_sLogFile.flush();
-#endif
-    }
 
-    nTimeout = 0;
-    while(!m_bGotModel){
-        getModel();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::this_thread::yield();
-        nTimeout++;
-        if(nTimeout>10) {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] timeout getting model" << std::endl;
-            m_sLogFile.flush();
-#endif
+        resendAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(CONNECT_RESEND_INTERVAL);
+        if(resendAt > deadline)
+            resendAt = deadline;
+
+        std::unique_lock<std::mutex> lock(m_ReplyMutex);
+        bDone = m_ReplyCond.wait_until(lock, resendAt, [&] {
+            if(!m_bIsConnected)
+                return true;
+            for(int j = 0; j < nQueries; j++) {
+                if(!*gotFlag(cQueries[j]))
+                    return false;
+            }
+            return true;
+        });
+        if(std::chrono::steady_clock::now() >= deadline)
             break;
-        }
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] waiting for model" << std::endl;
-        m_sLogFile.flush();
-#endif
     }
 
-    nTimeout = 0;
-    while(!m_bGotBluetoothName){
-        getBluetoothName();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::this_thread::yield();
-        nTimeout++;
-        if(nTimeout>MAX_TIMEOUT) {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] timeout getting Bluetooth name" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    for(i = 0; i < nQueries; i++) {
+        if(!*gotFlag(cQueries[i])) {
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "queryDeviceInfo", "timeout waiting for code 0x%02X", (int)cQueries[i]);
+            nErr = ERR_CMDFAILED;
         }
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] waiting for Bluetooth name" << std::endl;
-        m_sLogFile.flush();
-#endif
     }
+    return nErr;
+}
 
-    nTimeout = 0;
-    while(!m_bGotFriendlyName){
-        getFriendlyName();
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-        std::this_thread::yield();
-        nTimeout++;
-        if(nTimeout>MAX_TIMEOUT) {
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] timeout getting Friendly name" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-        }
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Connect] waiting for Friendly name" << std::endl;
-        m_sLogFile.flush();
-#endif
+void COasisController::requestDeviceMetadata()
+{
+    const byte cQueries[] = {CODE_GET_CONFIG, CODE_GET_VERSION, CODE_GET_PRODUCT_MODEL, CODE_GET_BLUETOOTH_NAME, CODE_GET_FRIENDLY_NAME};
+    CommandToken token;
+
+    // fire and forget, parseResponse will fill the values in the background.
+    // with a warm cache everything is asked again so the cached values get verified.
+    for(byte nCode : cQueries) {
+        if(m_bHaveDeviceCache || !*gotFlag(nCode))
+            sendQuery(nCode, token);
     }
+}
 
-    if(m_Oasis_Settings.bExternalSensorPresent)
-        setTemperatureSource(EXTERNAL);
+void COasisController::refreshDeviceNames()
+{
+    CommandToken token;
+
+    // fire and forget too, the settings dialog picks the names up from the state on its timer.
+    // a reconnect would make sendQuery wait for the link, the dialog can do without fresh names.
+    if(!m_bIsConnected || m_bNeedReconnect)
+        return;
+    sendQuery(CODE_GET_BLUETOOTH_NAME, token);
+    sendQuery(CODE_GET_FRIENDLY_NAME, token);
+}
 
-    return nErr;
+void COasisController::ensureDeviceInfo(byte nCode)
+{
+    if(*gotFlag(nCode) || !m_bIsConnected)
+        return;
+    queryDeviceInfo(&nCode, 1, METADATA_TIMEOUT);
 }
 
-void COasisController::Disconnect()
+std::atomic<bool> *COasisController::gotFlag(byte nCode)
 {
-    const std::lock_guard<std::mutex> lock(m_DevAccessMutex);
+    switch(nCode) {
+        case CODE_GET_CONFIG :
+            return &m_bGotconfig;
+        case CODE_GET_STATUS :
+            return &m_bGotStatus;
+        case CODE_GET_VERSION :
+            return &m_bGotVersion;
+        case CODE_GET_PRODUCT_MODEL :
+            return &m_bGotModel;
+        case CODE_GET_BLUETOOTH_NAME :
+            return &m_bGotBluetoothName;
+        case CODE_GET_FRIENDLY_NAME :
+            return &m_bGotFriendlyName;
+        default :
+            return &m_bGotconfig;
+    }
+}
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] Disconnecting from device." << std::endl;
-    m_sLogFile.flush();
-#endif
+void COasisController::Disconnect()
+{
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "Disconnect", "Disconnecting from device.");
+    // the I/O thread owns the device, once it's gone we can close it.
     stopThreads();
+
     if(m_bIsConnected)
-            hid_close(m_DevHandle);
+        devClose();
+    m_bIsConnected = false;
+    m_ReplyCond.notify_all();
+    m_FrameTrace.close();
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] Calling hid_exit." << std::endl;
-    m_sLogFile.flush();
-#endif
+    if(m_bHotplugUser) {
+        stopHotplugMonitor();
+        m_bHotplugUser = false;
+    }
+    // after the monitor, its thread enumerates through the runtime too.
+    detachHidRuntime();
 
-    hid_exit();
-    m_DevHandle = nullptr;
-	m_bIsConnected = false;
+    if(m_bFaultInjection)
+        m_FaultTransport.logFaultCounts();
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [Disconnect] Disconnected from device." << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "Disconnect", "Disconnected from device.");
+}
+
+int COasisController::sendCommand(byte *cHIDBuffer, int nTimeoutMs)
+{
+    int nErr = PLUGIN_OK;
+    CommandToken token;
+
+    nErr = sendCommandAsync(cHIDBuffer, token);
+    if(nErr)
+        return nErr;
+
+    nErr = waitForReply(token, nTimeoutMs);
+    return nErr;
 }
 
-int COasisController::sendCommand(byte *cHIDBuffer)
+int COasisController::sendCommandAsync(byte *cHIDBuffer, CommandToken &token)
 {
     int nErr = PLUGIN_OK;
-    int nByteWriten = 0;
     int nNbTimeOut = 0;
+    IOCommand cmd;
 
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    hexdump(cHIDBuffer,  REPORT_SIZE, m_hexOut);
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [sendCommand] sending : " << std::endl << m_hexOut << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLogHex(m_Logger, LOG_LEVEL_DEBUG, "sendCommandAsync", cHIDBuffer, REPORT_SIZE, "sending :");
+
+    // snapshot the reply counter for this code before writing so we can't miss a fast reply
+    token.nCode = cHIDBuffer[1];
+    {
+        const std::lock_guard<std::mutex> lock(m_ReplyMutex);
+        token.nSeq = m_nReplySeq[token.nCode];
+    }
+
+    // the device is being reopened by the watchdog, give it a chance to come back before failing.
+    if(m_bNeedReconnect && waitForLink(RECONNECT_TIMEOUT))
+        return ERR_COMMNOLINK;
+
+    memcpy(cmd.cBuffer, cHIDBuffer, REPORT_SIZE);
     nNbTimeOut = 0;
     while(nNbTimeOut < MAX_TIMEOUT) {
-        if(m_DevAccessMutex.try_lock()) {
-            nByteWriten = hid_write(m_DevHandle, cHIDBuffer, REPORT_SIZE);
-            m_DevAccessMutex.unlock();
-            if(nByteWriten<0) {
-                nNbTimeOut++;
-                std::this_thread::yield();
-            }
-            else {
-                break; // all good, no need to retry
-            }
-        }
-        else {
-            nNbTimeOut++;
-            std::this_thread::yield();
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // give time to the thread in case we got an error
+        if(m_CommandQueue.push(cmd))
+            break; // the I/O thread will write it
+        nNbTimeOut++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(CMD_RETRY_DELAY));
     }
 
     if(nNbTimeOut>=MAX_TIMEOUT) {
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [sendCommand] ERROR Timeout sending command : " << std::endl;
-        m_sLogFile.flush();
-#endif
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "sendCommandAsync", "ERROR command queue full : ");
         nErr = ERR_CMDFAILED;
     }
-    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // give time to the thread to read the returned report
+    wakeIO();
     return nErr;
 }
 
+int COasisController::waitForReply(const CommandToken &token, int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_ReplyMutex);
+    bool bGotReply;
+
+    bGotReply = m_ReplyCond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [&] {
+        return m_nReplySeq[token.nCode] != token.nSeq || !m_bIsConnected || m_bStopIO;
+    });
+
+    if(!m_bIsConnected || m_bStopIO)
+        return ERR_COMMNOLINK;
+
+    if(!bGotReply) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "waitForReply", "ERROR Timeout waiting for reply to code 0x%02X after %d ms", (int)token.nCode, (int)nTimeoutMs);
+        return ERR_CMDFAILED;
+    }
+    return PLUGIN_OK;
+}
+
+void COasisController::completeReply(byte nCode)
+{
+    {
+        const std::lock_guard<std::mutex> lock(m_ReplyMutex);
+        m_nReplySeq[nCode]++;
+    }
+    m_ReplyCond.notify_all();
+}
+
+int COasisController::sendQuery(byte nCode, CommandToken &token)
+{
+    byte cHIDBuffer[REPORT_SIZE];
+
+    CFrameWriter<FrameHead> frame(cHIDBuffer, nCode);
+
+    return sendCommandAsync(cHIDBuffer, token);
+}
+
 int COasisController::listFocusers(std::vector<std::string> &focuserSNList)
 {
     int nErr = PLUGIN_OK;
-    hid_device_info *deviceInfoList, *curDev;;
-    std::wstring ws;
-    std::string sSerial;
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [listFocusers] called." << std::endl;
-    m_sLogFile.flush();
-#endif
+    bool bFresh;
 
-    deviceInfoList = hid_enumerate(VENDOR_ID, PRODUCT_ID);
-    curDev = deviceInfoList;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "listFocusers", "called.");
 
-    for (curDev = deviceInfoList; curDev != nullptr; curDev = curDev->next) {
-        ws.assign(curDev->serial_number);
-        sSerial.assign(ws.begin(), ws.end());
+    if(m_nTransport == TRANSPORT_SIMULATOR) {
+        focuserSNList.assign(1, SIM_SERIAL);
+        return nErr;
+    }
 
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [listFocusers] SN : " << sSerial << std::endl;
-        m_sLogFile.flush();
-#endif
-        focuserSNList.push_back(sSerial);
+    {
+        const std::lock_guard<std::mutex> lock(g_EnumMutex);
+        bFresh = g_bEnumValid && (g_bHotplugRunning || g_EnumTimer.GetElapsedSeconds()*1000 < ENUM_CACHE_TTL);
+        if(bFresh)
+            focuserSNList = g_EnumSerials;
     }
+
+    if(!bFresh) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "listFocusers", "enumerating devices.");
+        attachHidRuntime();
+        refreshFocuserList();
+        const std::lock_guard<std::mutex> lock(g_EnumMutex);
+        focuserSNList = g_EnumSerials;
+    }
+
+    for (const std::string &sSerial : focuserSNList)
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "listFocusers", "SN : %s", sSerial.c_str());
     return nErr;
 }
 
@@ -404,14 +697,109 @@ bool COasisController::isFocuserPresent(std::string sSerial)
 
 void COasisController::setFocuserSerial(std::string sSerial)
 {
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setFocuserSerial] Setting focuser serial to " << sSerial << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setFocuserSerial", "Setting focuser serial to %s", sSerial.c_str());
 
+    if(sSerial != m_sSerialNumber)
+        clearDeviceCache(); // the cache belongs to the previous focuser
     m_sSerialNumber.assign(sSerial);
 }
 
+void COasisController::setDeviceCache(const Oasis_Device_Cache &cache)
+{
+    const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+    m_DeviceCache = cache;
+    m_bHaveDeviceCache = true;
+}
+
+void COasisController::clearDeviceCache()
+{
+    const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+    m_bHaveDeviceCache = false;
+}
+
+bool COasisController::getDeviceCache(Oasis_Device_Cache &cache)
+{
+    // only hand out values that were confirmed by the focuser during this link
+    if(!m_bIsConnected || !m_bLiveVersion || !m_bLiveConfig)
+        return false;
+
+    // this runs from terminateLink, never wait for the device here.
+    if(!m_bGotModel || !m_bGotBluetoothName || !m_bGotFriendlyName)
+        return false;
+
+    const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+    cache.sVersion.assign(m_Oasis_Settings.sVersion.c_str());
+    cache.sModel.assign(m_Oasis_Settings.sModel.c_str());
+    cache.sBluetoothName.assign(m_Oasis_Settings.sBluetoothName.c_str());
+    cache.sFriendlyName.assign(m_Oasis_Settings.sFriendlyName.c_str());
+    cache.nMaxPos = m_Oasis_Settings.nMaxPos;
+    cache.backlash = m_Oasis_Settings.backlash;
+    cache.backlashDirection = m_Oasis_Settings.backlashDirection;
+    cache.bIsReversed = m_Oasis_Settings.bIsReversed;
+    cache.speed = m_Oasis_Settings.speed;
+    cache.beepOnMove = m_Oasis_Settings.beepOnMove;
+    cache.beepOnStartup = m_Oasis_Settings.beepOnStartup;
+    cache.bluetoothOn = m_Oasis_Settings.bluetoothOn;
+    return true;
+}
+
+void COasisController::applyDeviceCache()
+{
+    const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+
+    m_Oasis_Settings.sVersion.assign(m_DeviceCache.sVersion);
+    m_Oasis_Settings.sModel.assign(m_DeviceCache.sModel);
+    m_Oasis_Settings.sBluetoothName.assign(m_DeviceCache.sBluetoothName);
+    m_Oasis_Settings.sFriendlyName.assign(m_DeviceCache.sFriendlyName);
+    m_Oasis_Settings.nMaxPos = m_DeviceCache.nMaxPos;
+    m_Oasis_Settings.backlash = m_DeviceCache.backlash;
+    m_Oasis_Settings.backlashDirection = m_DeviceCache.backlashDirection;
+    m_Oasis_Settings.bIsReversed = m_DeviceCache.bIsReversed;
+    m_Oasis_Settings.speed = m_DeviceCache.speed;
+    m_Oasis_Settings.beepOnMove = m_DeviceCache.beepOnMove;
+    m_Oasis_Settings.beepOnStartup = m_DeviceCache.beepOnStartup;
+    m_Oasis_Settings.bluetoothOn = m_DeviceCache.bluetoothOn;
+    publishState();
+
+    m_bGotconfig = true;
+    m_bGotVersion = true;
+    m_bGotModel = true;
+    m_bGotBluetoothName = true;
+    m_bGotFriendlyName = true;
+}
+
+// copy the working settings into m_State, the caller holds m_GlobalMutex so there's only one writer
+void COasisController::publishState()
+{
+    Oasis_State state;
+
+    state.nCurPos = m_Oasis_Settings.nCurPos;
+    state.nMaxPos = m_Oasis_Settings.nMaxPos;
+    state.bIsMoving = m_Oasis_Settings.bIsMoving;
+    state.bIsReversed = m_Oasis_Settings.bIsReversed;
+    state.fInternal = m_Oasis_Settings.fInternal;
+    state.fAmbient = m_Oasis_Settings.fAmbient;
+    state.bExternalSensorPresent = m_Oasis_Settings.bExternalSensorPresent;
+    state.backlash = m_Oasis_Settings.backlash;
+    state.backlashDirection = m_Oasis_Settings.backlashDirection;
+    state.speed = m_Oasis_Settings.speed;
+    state.beepOnMove = m_Oasis_Settings.beepOnMove;
+    state.beepOnStartup = m_Oasis_Settings.beepOnStartup;
+    state.bluetoothOn = m_Oasis_Settings.bluetoothOn;
+    state.sVersion = m_Oasis_Settings.sVersion;
+    state.sModel = m_Oasis_Settings.sModel;
+    state.sSerial = m_Oasis_Settings.sSerial;
+    state.sBluetoothName = m_Oasis_Settings.sBluetoothName;
+    state.sFriendlyName = m_Oasis_Settings.sFriendlyName;
+
+    m_State.write(state);
+}
+
+uint32_t COasisController::getState(Oasis_State &state)
+{
+    return m_State.read(state);
+}
+
 void COasisController::setUserConf(bool bUserConf)
 {
     m_bSetUserConf = bUserConf;
@@ -419,18 +807,30 @@ void COasisController::setUserConf(bool bUserConf)
 
 void COasisController::startThreads()
 {
-    if(!m_ThreadsAreRunning) {
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [startThreads] Starting HID threads." << std::endl;
-        m_sLogFile.flush();
-#endif
-        m_exitSignal = new std::promise<void>();
-        m_futureObj = m_exitSignal->get_future();
-        m_exitSignalSender = new std::promise<void>();
-        m_futureObjSender = m_exitSignalSender->get_future();
+    IOCommand cmd;
 
-        m_th = std::thread(&threaded_poller, std::move(m_futureObj), this, m_DevHandle);
-        m_thSender = std::thread(&threaded_sender, std::move(m_futureObjSender), this,  m_DevHandle);
+    if(!m_ThreadsAreRunning) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "startThreads", "Starting I/O and parser threads.");
+        // nothing from a previous link goes to the device, there's no consumer yet so it's safe to pop here.
+        while(m_CommandQueue.pop(cmd)) {}
+        m_bHaveRetryCmd = false;
+        m_bHaltRequested = false;
+        m_bRestorePending = false;
+        // same for reports, neither thread is running yet
+        m_ReportRing.clear();
+        m_nRingHighWater = 0;
+        m_nRingOverflows = 0;
+        m_nRingOverflowsLogged = 0;
+        m_bStopParser = false;
+        m_thParser = std::thread(&threaded_parser, this);
+
+        m_bStopIO = false;
+        m_bStatusPending = false;
+        m_bStatusRefresh = true; // get the first status right away
+        m_nStatusInterval = STATUS_POLL_IDLE_MIN;
+        m_nextStatusTime = std::chrono::steady_clock::now();
+
+        m_th = std::thread(&threaded_io, this);
         m_ThreadsAreRunning = true;
     }
 }
@@ -438,37 +838,554 @@ void COasisController::startThreads()
 void COasisController::stopThreads()
 {
     if(m_ThreadsAreRunning) {
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [stopThreads] Waiting for threads to exit." << std::endl;
-        m_sLogFile.flush();
-#endif
-        m_exitSignal->set_value();
-        m_exitSignalSender->set_value();
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "stopThreads", "Waiting for the I/O and parser threads to exit.");
+        {
+            const std::lock_guard<std::mutex> lock(m_IOMutex);
+            m_bStopIO = true;
+        }
+        m_IOCond.notify_all(); // in case it's backing off after an error or between reconnect attempts
+        wakeIO();
         m_th.join();
-        m_thSender.join();
-        delete m_exitSignal;
-        delete m_exitSignalSender;
-        m_exitSignal = nullptr;
-        m_exitSignalSender = nullptr;
+        // nothing pushes reports anymore, the parser can go
+        m_bStopParser = true;
+        m_ParserCond.notify_all();
+        m_thParser.join();
         m_ThreadsAreRunning = false;
     }
 }
 
+void COasisController::waitIOBackoff(int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_IOMutex);
+    m_IOCond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [&] {
+        return (bool)m_bStopIO;
+    });
+}
+
+#pragma mark I/O thread
+
+void COasisController::flushCommands()
+{
+    IOCommand cmd;
+
+    flushHalt();
+
+    if(m_bHaveRetryCmd) {
+        if(devWrite(m_RetryCmd.cBuffer, REPORT_SIZE) < 0) {
+            signalLinkError();
+            return;
+        }
+        m_bHaveRetryCmd = false;
+    }
+
+    while(m_CommandQueue.pop(cmd)) {
+        if(devWrite(cmd.cBuffer, REPORT_SIZE) < 0) {
+            // keep it for after the reconnect, the rest stays in the queue.
+            m_RetryCmd = cmd;
+            m_bHaveRetryCmd = true;
+            signalLinkError();
+            return;
+        }
+        flushHalt(); // a halt that came in meanwhile doesn't wait for the rest of the queue
+    }
+}
+
+void COasisController::requestHalt(CommandToken &token)
+{
+    // snapshot the reply counter first, same as sendCommandAsync
+    token.nCode = CODE_CMD_STOP_MOVE;
+    {
+        const std::lock_guard<std::mutex> lock(m_ReplyMutex);
+        token.nSeq = m_nReplySeq[token.nCode];
+    }
+    m_nHaltRequestTime = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    m_bHaltRequested = true;
+    wakeIO();
+}
+
+void COasisController::flushHalt()
+{
+    byte cHIDBuffer[REPORT_SIZE];
+    int64_t nNow;
+    int nLatency;
+
+    if(!m_bHaltRequested.exchange(false))
+        return;
+
+    CFrameWriter<FrameHead> frame(cHIDBuffer, CODE_CMD_STOP_MOVE);
+    if(devWrite(cHIDBuffer, sizeof(cHIDBuffer)) < 0) {
+        m_bHaltRequested = true; // try again once the device is back
+        signalLinkError();
+        return;
+    }
+
+    nNow = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    nLatency = (int)(nNow - m_nHaltRequestTime);
+    m_nHaltLatency = nLatency;
+    if(nLatency > m_nHaltLatencyMax)
+        m_nHaltLatencyMax = nLatency;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "flushHalt", "halt written %d us after the request, worst so far %d us", (int)nLatency, (int)m_nHaltLatencyMax);
+}
+
+void COasisController::getHaltLatency(int &nLastUs, int &nMaxUs)
+{
+    nLastUs = m_nHaltLatency;
+    nMaxUs = m_nHaltLatencyMax;
+}
+
+int COasisController::nextIOTimeout()
+{
+    int nTimeoutMs;
+    int nStallMs;
+
+    if(m_bStatusRefresh || m_bHaltRequested)
+        return 0;
+
+    // round up, a deadline less than 1 ms away would otherwise turn into a busy loop of 0 ms reads
+    nTimeoutMs = (int)std::chrono::ceil<std::chrono::milliseconds>(m_nextStatusTime - std::chrono::steady_clock::now()).count();
+    // wake up in time for the watchdog if we're waiting on a status reply
+    if(m_bStatusPending) {
+        nStallMs = m_nStallTimeout - (int)(m_stallTimer.GetElapsedSeconds()*1000) + 1;
+        if(nStallMs < nTimeoutMs)
+            nTimeoutMs = nStallMs;
+    }
+    return nTimeoutMs < 0 ? 0 : nTimeoutMs;
+}
+
+#pragma mark parser thread
+
+// called by the I/O thread, never blocks. A full ring drops the report, the parser is the one falling behind.
+bool COasisController::queueReport(const byte *cHIDBuffer, int nLength)
+{
+    RawReport report;
+    int nOccupancy;
+
+    if(nLength > REPORT_SIZE)
+        nLength = REPORT_SIZE;
+    m_FrameTrace.record(TRACE_RX, cHIDBuffer, nLength);
+    memcpy(report.cBuffer, cHIDBuffer, nLength);
+    report.nLength = nLength;
+    if(!m_ReportRing.push(report)) {
+        m_nRingOverflows++;
+        return false;
+    }
+
+    nOccupancy = (int)m_ReportRing.size();
+    if(nOccupancy > m_nRingHighWater)
+        m_nRingHighWater = nOccupancy;
+
+    // pairs with the fence in waitForReports, either we see the parser idle or it sees our report
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(m_bParserIdle)
+        m_ParserCond.notify_one();
+    return true;
+}
+
+void COasisController::parseReports()
+{
+    RawReport report;
+    uint32_t nOverflows;
+
+    while(m_ReportRing.pop(report))
+        parseResponse(report.cBuffer, report.nLength);
+
+    nOverflows = m_nRingOverflows;
+    if(nOverflows != m_nRingOverflowsLogged) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "parseReports", "report ring overflowed, %d report(s) dropped, %d total", (int)(nOverflows - m_nRingOverflowsLogged), (int)nOverflows);
+        m_nRingOverflowsLogged = nOverflows;
+    }
+}
+
+void COasisController::waitForReports()
+{
+    std::unique_lock<std::mutex> lock(m_ParserMutex);
+
+    m_bParserIdle = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // the reader notifies without the lock, a wake up can slip in before we block, hence the timeout.
+    m_ParserCond.wait_for(lock, std::chrono::milliseconds(PARSER_WAIT_TIMEOUT), [&] {
+        return m_ReportRing.size() || m_bStopParser;
+    });
+    m_bParserIdle = false;
+}
+
+void COasisController::getReportRingStats(int &nOccupancy, int &nHighWater, uint32_t &nOverflows)
+{
+    nOccupancy = (int)m_ReportRing.size();
+    nHighWater = m_nRingHighWater;
+    nOverflows = m_nRingOverflows;
+}
+
+#pragma mark status polling
+
+int COasisController::nextStatusInterval(int nPrevIntervalMs)
+{
+    if(m_Oasis_Settings.bIsMoving || m_bGotoPending)
+        return STATUS_POLL_FAST;
+
+    // idle : start from STATUS_POLL_IDLE_MIN right after a move and double up to STATUS_POLL_IDLE_MAX
+    if(nPrevIntervalMs < STATUS_POLL_IDLE_MIN)
+        return STATUS_POLL_IDLE_MIN;
+    return (nPrevIntervalMs * 2 > STATUS_POLL_IDLE_MAX) ? STATUS_POLL_IDLE_MAX : nPrevIntervalMs * 2;
+}
+
+void COasisController::pollStatus()
+{
+    // poll fast while moving, back off exponentially when idle, right away on refresh requests.
+    if(!m_bStatusRefresh && std::chrono::steady_clock::now() < m_nextStatusTime)
+        return;
+    m_bStatusRefresh = false;
+    sendStatusRequest();
+    m_nStatusInterval = nextStatusInterval(m_nStatusInterval);
+    m_nextStatusTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_nStatusInterval);
+}
+
+int COasisController::sendStatusRequest()
+{
+    byte cHIDBuffer[REPORT_SIZE];
+
+    // only one status request in flight, unless the previous one was lost
+    if(m_bStatusPending && m_statusTimer.GetElapsedSeconds() < STATUS_REPLY_TIMEOUT / 1000.0f)
+        return PLUGIN_OK;
+
+    CFrameWriter<FrameHead> frame(cHIDBuffer, CODE_GET_STATUS);
+    if(devWrite(cHIDBuffer, sizeof(cHIDBuffer)) < 0) {
+        signalLinkError();
+        return ERR_CMDFAILED;
+    }
+
+    // the watchdog measures from the first request of a series, re-sends don't restart it.
+    if(!m_bStatusPending)
+        m_stallTimer.Reset();
+    m_statusTimer.Reset();
+    m_bStatusPending = true;
+    return PLUGIN_OK;
+}
+
+void COasisController::requestStatusRefresh()
+{
+    m_bStatusRefresh = true;
+    wakeIO();
+}
+
+int COasisController::waitForStatus(int nTimeoutMs)
+{
+    CommandToken token;
+
+    // status frames complete their code like any reply, snapshot the counter before asking
+    token.nCode = CODE_GET_STATUS;
+    {
+        const std::lock_guard<std::mutex> lock(m_ReplyMutex);
+        token.nSeq = m_nReplySeq[token.nCode];
+    }
+    requestStatusRefresh();
+    return waitForReply(token, nTimeoutMs);
+}
+
+#pragma mark link watchdog
+
+bool COasisController::isLinkStalled()
+{
+    if(m_bLinkError)
+        return true;
+    return m_bStatusPending && m_stallTimer.GetElapsedSeconds()*1000 > m_nStallTimeout;
+}
+
+void COasisController::signalLinkError()
+{
+    if(m_bLinkError || !m_bIsConnected)
+        return;
+    m_bLinkError = true;
+    wakeIO(); // the I/O thread owns the reconnect
+}
+
+void COasisController::setStallTimeout(int nTimeoutMs)
+{
+    m_nStallTimeout = nTimeoutMs > 0 ? nTimeoutMs : LINK_STALL_TIMEOUT;
+}
+
+int COasisController::setFrameTrace(bool bEnabled)
+{
+    // the I/O thread records without a lock, only switch while it's not running.
+    // the file itself is only created by Connect, see openFrameTrace
+    if(m_bIsConnected)
+        return ERR_CMDFAILED;
+
+    m_bFrameTrace = bEnabled;
+    return PLUGIN_OK;
+}
+
+// one file per focuser, Oasis-Trace-<serial>.bin in the home folder. The trace of the previous
+// connection is kept as Oasis-Trace-<serial>.prev.bin, a restart after a problem doesn't wipe the one that showed it.
+void COasisController::openFrameTrace()
+{
+    std::string sName("Oasis-Trace");
+    std::string sPath;
+    std::string sPrevPath;
+    FILE *pFile;
+
+    if(m_sSerialNumber.size()) {
+        sName += "-";
+        for(char c : m_sSerialNumber)
+            sName += (isalnum((unsigned char)c) || c == '-' || c == '_') ? c : '_';
+    }
+    sPath = m_sTraceFolder + sName + ".bin";
+    sPrevPath = m_sTraceFolder + sName + ".prev.bin";
+
+    remove(sPrevPath.c_str());
+    if(rename(sPath.c_str(), sPrevPath.c_str()) != 0) {
+        // no previous trace is fine, one we couldn't move out of the way isn't overwritten
+        pFile = fopen(sPath.c_str(), "rb");
+        if(pFile) {
+            fclose(pFile);
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "openFrameTrace", "can't rotate %s, not tracing", sPath.c_str());
+            return;
+        }
+    }
+
+    if(!m_FrameTrace.open(sPath)) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "openFrameTrace", "can't create %s", sPath.c_str());
+        return;
+    }
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "openFrameTrace", "tracing HID reports to %s", sPath.c_str());
+}
+
+int COasisController::waitForLink(int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_ReplyMutex);
+
+    m_ReplyCond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [&] {
+        return !m_bNeedReconnect || !m_bIsConnected;
+    });
+    if(m_bNeedReconnect || !m_bIsConnected)
+        return ERR_COMMNOLINK;
+    return PLUGIN_OK;
+}
+
+// called from the I/O thread when the watchdog fires, the same serial is reopened.
+// Meanwhile commands wait in sendCommandAsync so TheSkyX doesn't see an error.
+int COasisController::reopenDevice()
+{
+    int nErr = Oasis_CANT_CONNECT;
+    CStopWatch reconnectTimer;
+
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "reopenDevice", "link to %s%s, reconnecting.", m_sSerialNumber.c_str(), (m_bLinkError?" failed":" stalled"));
+    m_nPosBeforeReconnect = m_Oasis_Settings.nCurPos;
+    m_bCheckPosition = !m_Oasis_Settings.bIsMoving; // if it was moving the position is expected to change
+    m_bNeedReconnect = true;
+
+    while(!m_bStopIO) {
+        devClose();
+        nErr = devOpen();
+        if(nErr == PLUGIN_OK)
+            break;
+        waitIOBackoff(RECONNECT_RETRY_DELAY);
+    }
+    if(nErr != PLUGIN_OK)
+        return nErr; // we're being stopped, Disconnect takes care of the rest
+
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "reopenDevice", "reconnected in %f ms", reconnectTimer.GetElapsedSeconds()*1000);
+
+    m_bLinkError = false;
+    m_bStatusPending = false;
+    m_bGotStatus = false;
+    // restoreAfterReconnect works from the first fresh status, ask for it right away.
+    m_bRestorePending = true;
+    m_bStatusRefresh = true;
+
+    {
+        const std::lock_guard<std::mutex> lock(m_ReplyMutex);
+        m_bNeedReconnect = false;
+    }
+    m_ReplyCond.notify_all();
+    return PLUGIN_OK;
+}
+
+void COasisController::checkRestore()
+{
+    if(m_bRestorePending && m_bGotStatus) {
+        m_bRestorePending = false;
+        restoreAfterReconnect();
+    }
+}
+
+// runs on the parser thread, so only queue commands here, never wait for their replies.
+void COasisController::restoreAfterReconnect()
+{
+    CommandToken token;
+
+    if(m_Oasis_Settings.bIsMoving)
+        return; // still on its way, isGoToComplete takes it from there
+
+    // it was idle, any change means the focuser rebooted and lost its position.
+    if(m_bCheckPosition && m_Oasis_Settings.nCurPos != (uint32_t)m_nPosBeforeReconnect) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "restoreAfterReconnect", "position changed from %d to %d, restoring it.", (int)m_nPosBeforeReconnect, (int)m_Oasis_Settings.nCurPos);
+        queueSyncPosition((unsigned int)m_nPosBeforeReconnect, token);
+    }
+    m_bCheckPosition = false;
+
+    // the goto was lost with the link, send it again.
+    if(m_bGotoPending && m_Oasis_Settings.nCurPos != m_nTargetPos) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "restoreAfterReconnect", "resuming goto to %d", (int)m_nTargetPos);
+        queueGoto(m_nTargetPos, token);
+    }
+}
+
+#pragma mark device access
+
+int COasisController::devOpen()
+{
+    m_nActiveTransport = TRANSPORT_HIDAPI;
+
+    if(m_nTransport == TRANSPORT_SIMULATOR)
+        return openTransport(m_Simulator);
+
+#ifdef SB_LINUX_BUILD
+    if(m_nTransport == TRANSPORT_HIDRAW) {
+        if(openTransport(m_HidrawTransport) == PLUGIN_OK)
+            return PLUGIN_OK;
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "devOpen", "hidraw open failed, falling back to hidapi.");
+    }
+#endif
+
+    return openTransport(m_HidapiTransport);
+}
+
+// hid_init is only paid for once this instance actually talks to the bus, the list dialog and Connect do.
+void COasisController::attachHidRuntime()
+{
+    if(!m_bHidUser.exchange(true))
+        acquireHidRuntime();
+}
+
+void COasisController::detachHidRuntime()
+{
+    if(m_bHidUser.exchange(false))
+        releaseHidRuntime();
+}
+
+int COasisController::openTransport(COasisTransport &transport)
+{
+    COasisTransport *pTransport = &transport;
+    std::string sSerial(m_sSerialNumber);
+
+    if(m_bFaultInjection) {
+        m_FaultTransport.setTransport(&transport);
+        pTransport = &m_FaultTransport;
+    }
+
+    if(!pTransport->open(sSerial))
+        return Oasis_CANT_CONNECT;
+
+    // opened the first one available, remember which so a reconnect gets the same focuser back
+    if(!m_sSerialNumber.size())
+        m_sSerialNumber.assign(sSerial);
+    m_pTransport = pTransport;
+    m_nActiveTransport = transport.type();
+    m_bDeviceOpen = true;
+    return PLUGIN_OK;
+}
+
+void COasisController::devClose()
+{
+    m_bDeviceOpen = false;
+    m_pTransport.load()->close();
+}
+
+bool COasisController::isDeviceOpen()
+{
+    if(m_bNeedReconnect)
+        return true; // being reopened, commands wait for it in sendCommandAsync
+    return m_bDeviceOpen;
+}
+
+int COasisController::devWrite(const byte *cHIDBuffer, int nLength)
+{
+    int nRet;
+
+    nRet = m_pTransport.load()->write(cHIDBuffer, nLength);
+    if(nRet > 0)
+        m_FrameTrace.record(TRACE_TX, cHIDBuffer, nLength);
+    return nRet;
+}
+
+int COasisController::devRead(byte *cHIDBuffer, int nLength, int nTimeoutMs)
+{
+    return m_pTransport.load()->read(cHIDBuffer, nLength, nTimeoutMs);
+}
+
+void COasisController::wakeIO()
+{
+    m_pTransport.load()->wake();
+}
+
+void COasisController::setTransport(int nTransport)
+{
+    switch(nTransport) {
+        case TRANSPORT_SIMULATOR :
+            m_nTransport = TRANSPORT_SIMULATOR;
+            break;
+#ifdef SB_LINUX_BUILD
+        case TRANSPORT_HIDRAW :
+            m_nTransport = TRANSPORT_HIDRAW;
+            break;
+#endif
+        default :
+            m_nTransport = TRANSPORT_HIDAPI; // hidraw is Linux only
+            break;
+    }
+}
+
+void COasisController::setSimulatorProbe(bool bPresent)
+{
+    m_Simulator.setProbePresent(bPresent);
+}
+
+// empty to turn it off, see COasisFaultTransport::parseProfile for the format
+int COasisController::setFaultInjection(const std::string &sSpec)
+{
+    FaultProfile profile;
+
+    if(m_bIsConnected)
+        return ERR_CMDFAILED;
+
+    if(sSpec.empty()) {
+        m_bFaultInjection = false;
+        return PLUGIN_OK;
+    }
+    if(!COasisFaultTransport::parseProfile(sSpec, profile)) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "setFaultInjection", "bad fault profile '%s'", sSpec.c_str());
+        return ERR_CMDFAILED;
+    }
+    m_FaultTransport.setProfile(profile);
+    m_bFaultInjection = true;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setFaultInjection", "injecting link faults : %s", sSpec.c_str());
+    return PLUGIN_OK;
+}
+
+int COasisController::getTransport()
+{
+    return m_nTransport;
+}
+
+int COasisController::getActiveTransport()
+{
+    return m_nActiveTransport;
+}
 
 int COasisController::getConfig()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    cHIDBuffer[0] = 0; // report ID
-    cHIDBuffer[1] = CODE_GET_CONFIG; // command
-    cHIDBuffer[2] = 0; // command length
+    nErr = sendQuery(CODE_GET_CONFIG, token);
+    if(nErr)
+        return nErr;
 
-    nErr = sendCommand(cHIDBuffer);
+    nErr = waitForReply(token);
     return nErr;
 }
 
@@ -476,33 +1393,43 @@ int COasisController::getConfig()
 int COasisController::haltFocuser()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
+    int nTry;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    if(m_Oasis_Settings.bIsMoving) {
-        cHIDBuffer[0] = 0; // report ID
-        cHIDBuffer[1] = CODE_CMD_STOP_MOVE; // command
-        cHIDBuffer[2] = 0; // command length
-
-        nErr = sendCommand(cHIDBuffer);
+    // a goto that was just acked may not show in the status yet, same test as the status poller
+    if(m_Oasis_Settings.bIsMoving || m_bGotoPending) {
+        for(nTry = 0; nTry < MAX_HALT_RETRY; nTry++) {
+            // skips the command queue, the I/O thread writes it before anything else
+            requestHalt(token);
+            nErr = waitForReply(token);
+            if(nErr != ERR_CMDFAILED)
+                break;
+            // the stop can get through with only its ack lost, the status tells
+            if(!waitForStatus() && !m_Oasis_Settings.bIsMoving) {
+                nErr = PLUGIN_OK;
+                break;
+            }
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "haltFocuser", "halt not acked and still moving, try %d of %d", nTry + 1, (int)MAX_HALT_RETRY);
+        }
     }
     m_nGotoTries = MAX_GOTO_RETRY+1; // prevent goto retries
+    m_bGotoPending = false;
+    requestStatusRefresh(); // get the stopped position right away
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(100)); // give time to the thread to read the returned report
     return nErr;
 }
 
 int COasisController::gotoPosition(long nPos)
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
-
-    DeclareFrame(FrameMoveTo, frameMove, CODE_CMD_MOVE_TO);
+    CommandToken token;
+    long nStartPos;
+    int nTry;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
 		return ERR_COMMNOLINK;
 
     if(m_Oasis_Settings.bIsMoving)
@@ -511,21 +1438,56 @@ int COasisController::gotoPosition(long nPos)
     if (nPos>m_Oasis_Settings.nMaxPos)
         return ERR_LIMITSEXCEEDED;
 
-    frameMove.position = htonl((unsigned int)nPos);
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameMove, sizeof(FrameMoveTo));
+    nStartPos = m_Oasis_Settings.nCurPos;
+    for(nTry = 0; nTry < MAX_GOTO_RETRY; nTry++) {
+        nErr = queueGoto(nPos, token);
+        if(!nErr)
+            nErr = waitForReply(token);
+        if(nErr != ERR_CMDFAILED)
+            break;
+        // only the ack may have been lost, if the device took the move isGoToComplete follows it from here
+        if(gotoStarted(nPos, nStartPos)) {
+            OasisLog(m_Logger, LOG_LEVEL_INFO, "gotoPosition", "no ack for the goto but the focuser is on its way");
+            nErr = PLUGIN_OK;
+            break;
+        }
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "gotoPosition", "goto to %d not acked and not started, try %d of %d", (int)nPos, nTry + 1, (int)MAX_GOTO_RETRY);
+    }
+    m_gotoTimer.Reset();
+    return nErr;
+}
+
+// asks for a fresh status and waits for it, the way the MOVE_TO ack is waited for
+bool COasisController::gotoStarted(long nPos, long nStartPos)
+{
+    long nCurPos;
+
+    if(waitForStatus())
+        return false;
+    if(m_Oasis_Settings.bIsMoving)
+        return true;
+    // a short move can be over before the status comes back
+    nCurPos = m_Oasis_Settings.nCurPos;
+    return nCurPos == nPos || labs(nPos - nCurPos) < labs(nPos - nStartPos);
+}
+
+int COasisController::queueGoto(long nPos, CommandToken &token)
+{
+    int nErr = PLUGIN_OK;
+    byte cHIDBuffer[REPORT_SIZE];
+
+    CFrameWriter<FrameMoveTo> frameMove(cHIDBuffer, CODE_CMD_MOVE_TO);
+    FrameSet(frameMove, FrameMoveTo, position, (unsigned int)nPos);
 
     m_nTargetPos = nPos;
 
-    #ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [gotoPosition] goto :  " << std::dec << nPos << " (0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << nPos <<")" << std::dec << std::endl;
-        m_sLogFile.flush();
-    #endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "queueGoto", "goto :  %d (0x%04X)", (int)nPos, (unsigned int)nPos);
 
 
-    nErr = sendCommand(cHIDBuffer);
+    m_bGotoPending = true;
+    nErr = sendCommandAsync(cHIDBuffer, token);
     m_gotoTimer.Reset();
+    requestStatusRefresh(); // switch to fast status polling now
     return nErr;
 }
 
@@ -533,16 +1495,13 @@ int COasisController::moveRelativeToPosision(long nSteps)
 {
     int nErr;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
     if(m_Oasis_Settings.bIsMoving)
         return ERR_CMD_IN_PROGRESS_FOC;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [moveRelativeToPosision] goto relative position : " << nSteps << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "moveRelativeToPosision", "goto relative position : %d", (int)nSteps);
 
     nErr = gotoPosition(m_Oasis_Settings.nCurPos + nSteps);
     return nErr;
@@ -554,37 +1513,35 @@ int COasisController::isGoToComplete(bool &bComplete)
 {
     int nErr = PLUGIN_OK;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
     bComplete = false;
 
+    if(m_bNeedReconnect && waitForLink(RECONNECT_TIMEOUT))
+        return ERR_COMMNOLINK;
+
     if(m_gotoTimer.GetElapsedSeconds()<0.5) { // focuser take a bit of time to start moving and reporting it's moving.
         return nErr;
     }
 
     if(m_Oasis_Settings.bIsMoving) {
-#ifdef PLUGIN_DEBUG
-        m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isGoToComplete] Complete : " << (bComplete?"Yes":"No") << std::endl;
-        m_sLogFile.flush();
-#endif
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "isGoToComplete", "Complete : %s", (bComplete?"Yes":"No"));
         return nErr;
     }
     bComplete = true;
 
     if(m_Oasis_Settings.nCurPos != m_nTargetPos) {
-        if(m_nGotoTries == 0) {
+        // the goto or its ack can get lost on the way, send it again until MAX_GOTO_RETRY
+        if(m_nGotoTries < MAX_GOTO_RETRY) {
             bComplete = false;
             m_nGotoTries++;
             gotoPosition(m_nTargetPos);
         }
-        else if (m_nGotoTries > MAX_GOTO_RETRY){
+        else {
             m_nGotoTries = 0;
             // we have an error as we're not moving but not at the target position
-#ifdef PLUGIN_DEBUG
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isGoToComplete] **** ERROR **** Not moving and not at the target position affter " << MAX_GOTO_RETRY << "tries." << std::endl;
-            m_sLogFile.flush();
-#endif
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "isGoToComplete", "**** ERROR **** Not moving and not at the target position affter %dtries.", (int)MAX_GOTO_RETRY);
             m_nTargetPos = m_Oasis_Settings.nCurPos;
             nErr = ERR_CMDFAILED;
         }
@@ -594,10 +1551,9 @@ int COasisController::isGoToComplete(bool &bComplete)
         m_nGotoTries = 0;
     }
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [isGoToComplete] Complete : " << (bComplete?"Yes":"No") << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "isGoToComplete", "Complete : %s", (bComplete?"Yes":"No"));
+    if(bComplete)
+        m_bGotoPending = false;
     return nErr;
 }
 
@@ -605,92 +1561,69 @@ int COasisController::isGoToComplete(bool &bComplete)
 int COasisController::getVersions()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    DeclareFrameHead(frame, CODE_GET_VERSION);
-    
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frame, sizeof(FrameHead));
+    nErr = sendQuery(CODE_GET_VERSION, token);
+    if(nErr)
+        return nErr;
 
-    nErr = sendCommand(cHIDBuffer);
+    nErr = waitForReply(token);
     return nErr;
 }
 
 void COasisController::getVersions(std::string &sVersion)
 {
-    sVersion.assign(m_Oasis_Settings.sVersion);
+    Oasis_State state;
+
+    ensureDeviceInfo(CODE_GET_VERSION);
+    getState(state);
+    sVersion.assign(state.sVersion.c_str());
 }
 
 int COasisController::getModel()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    DeclareFrameHead(frame, CODE_GET_PRODUCT_MODEL);
-
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frame, sizeof(FrameHead));
+    nErr = sendQuery(CODE_GET_PRODUCT_MODEL, token);
+    if(nErr)
+        return nErr;
 
-    nErr = sendCommand(cHIDBuffer);
+    nErr = waitForReply(token);
     return nErr;
-
 }
 
 void COasisController::getModel(std::string &sModel)
 {
-    sModel.assign(m_Oasis_Settings.sModel);
+    Oasis_State state;
+
+    ensureDeviceInfo(CODE_GET_PRODUCT_MODEL);
+    getState(state);
+    sModel.assign(state.sModel.c_str());
 }
 
 int COasisController::getSerial()
 {
     int nErr = PLUGIN_OK;
-    wchar_t TmpStr[128];
-    int nNbTimeOut = 0;
-    std::wstring ws;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getSerial]" << std::endl;
-    m_sLogFile.flush();
-#endif
-    nNbTimeOut = 0;
-    while(nNbTimeOut < MAX_TIMEOUT) {
-        if(m_DevAccessMutex.try_lock()) {
-            nErr = hid_get_serial_number_string(m_DevHandle, TmpStr, sizeof(TmpStr)/sizeof(wchar_t) );
-            m_DevAccessMutex.unlock();
-            // if(nByteWriten<0) {
-            if(nErr<0) {
-                nNbTimeOut++;
-                std::this_thread::yield();
-            }
-            else {
-                break; // all good, no need to retry
-            }
-        }
-        else {
-            nNbTimeOut++;
-            std::this_thread::yield();
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100)); // give time to the thread in case we got an error
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "getSerial", "called.");
+    // devOpen knows which serial it opened, on both transports, no need to ask the device.
+    {
+        const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+        m_Oasis_Settings.sSerial.assign(m_sSerialNumber);
+        publishState();
     }
 
-    ws.assign(TmpStr);
-    m_Oasis_Settings.sSerial.assign(ws.begin(), ws.end());
-
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [getSerial] serial : " << m_Oasis_Settings.sSerial << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "getSerial", "serial : %s", m_Oasis_Settings.sSerial.c_str());
 
     return nErr;
 }
@@ -699,282 +1632,303 @@ int COasisController::getSerial()
 int COasisController::getBluetoothName()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    DeclareFrameHead(frame, CODE_GET_BLUETOOTH_NAME);
-
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frame, sizeof(FrameHead));
+    nErr = sendQuery(CODE_GET_BLUETOOTH_NAME, token);
+    if(nErr)
+        return nErr;
 
-    nErr = sendCommand(cHIDBuffer);
+    nErr = waitForReply(token);
     return nErr;
-
 }
 
 int COasisController::getFriendlyName()
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-    DeclareFrameHead(frame, CODE_GET_FRIENDLY_NAME);
+    nErr = sendQuery(CODE_GET_FRIENDLY_NAME, token);
+    if(nErr)
+        return nErr;
 
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frame, sizeof(FrameHead));
-    
-    nErr = sendCommand(cHIDBuffer);
+    nErr = waitForReply(token);
     return nErr;
-
 }
 
 
 int COasisController::setMaxStep(unsigned int nMaxStep)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setMaxStep] setting max steps to :  " << std::dec << nMaxStep << " (0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << nMaxStep <<")" << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_MAX_STEP);
-    frameConfig.maxStep = htonl(nMaxStep);
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setMaxStep", "setting max steps to :  %d (0x%04X)", (int)nMaxStep, (unsigned int)nMaxStep);
 
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
-
-    nErr = sendCommand(cHIDBuffer);
-    return nErr;
+    config.setMaxStep(nMaxStep);
+    return commitConfig(config);
 }
 
 uint32_t COasisController::getBacklash()
 {
-    return m_Oasis_Settings.backlash;
+    Oasis_State state;
+
+    getState(state);
+    return state.backlash;
 }
 
 int COasisController::setBacklash(unsigned int nBacklash)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBacklash] setting Backlash to :  " << std::dec << nBacklash << " (0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << nBacklash <<")" << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_BACKLASH);
-    frameConfig.backlash = htonl(nBacklash);
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBacklash", "setting Backlash to :  %d (0x%04X)", (int)nBacklash, (unsigned int)nBacklash);
 
-    nErr = sendCommand(cHIDBuffer);
-
-    return nErr;
+    config.setBacklash(nBacklash);
+    return commitConfig(config);
 }
 
 uint8_t COasisController::getBacklashDirection()
 {
-    return m_Oasis_Settings.backlashDirection;
+    Oasis_State state;
+
+    getState(state);
+    return state.backlashDirection;
 }
 
 int COasisController::setBacklashDirection(byte nBacklashDir)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBacklashDirection] setting backlashDirection to :  " << std::dec << nBacklashDir << " (0x" << std::uppercase << std::setfill('0') << std::setw(2) << std::hex << nBacklashDir <<")" << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_BACKLASH_DIRECTION);
-    frameConfig.backlashDirection = nBacklashDir;
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBacklashDirection", "setting backlashDirection to :  %d (0x%02X)", (int)nBacklashDir, (unsigned int)nBacklashDir);
 
-    nErr = sendCommand(cHIDBuffer);
-
-    return nErr;
+    config.setBacklashDirection(nBacklashDir);
+    return commitConfig(config);
 }
 
 bool  COasisController::getReverse()
 {
-    return m_Oasis_Settings.bIsReversed;
+    Oasis_State state;
+
+    getState(state);
+    return state.bIsReversed;
 }
 
 int COasisController::setReverse(bool setReverse)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setReverse] setting setReverse to :  " << (setReverse?"Reverse":"Normal") << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_REVERSE_DIRECTION);
-    frameConfig.reverseDirection = setReverse?1:0;
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setReverse", "setting setReverse to :  %s", (setReverse?"Reverse":"Normal"));
 
-    nErr = sendCommand(cHIDBuffer);
-
-    return nErr;
+    config.setReverse(setReverse);
+    return commitConfig(config);
 }
 
 uint32_t COasisController::getSpeed()
 {
-    return m_Oasis_Settings.speed;
+    Oasis_State state;
+
+    getState(state);
+    return state.speed;
 }
 
 int COasisController::setSpeed(unsigned int nSpeed)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setSpeed] setting speed to :  " << std::dec << nSpeed << " (0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << nSpeed <<")" << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_SPEED);
-    frameConfig.speed = nSpeed;
-
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
-
-    nErr = sendCommand(cHIDBuffer);
-
-    return nErr;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setSpeed", "setting speed to :  %d (0x%04X)", (int)nSpeed, (unsigned int)nSpeed);
 
+    config.setSpeed((uint8_t)nSpeed);
+    return commitConfig(config);
 }
 
 bool COasisController::getBeepOnMove()
 {
-    return m_Oasis_Settings.beepOnMove==1;
+    Oasis_State state;
+
+    getState(state);
+    return state.beepOnMove==1;
 }
 
 int COasisController::setBeepOnMove(bool bEnabled)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBeepOnMove] setting beep on move to :  " << (bEnabled?"True":"False") << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = ntohl(MASK_BEEP_ON_MOVE);
-    frameConfig.beepOnMove = bEnabled?1:0;
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
-
-    nErr = sendCommand(cHIDBuffer);
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBeepOnMove", "setting beep on move to :  %s", (bEnabled?"True":"False"));
 
-    return nErr;
+    config.setBeepOnMove(bEnabled);
+    return commitConfig(config);
 }
 
 bool COasisController::getBeepOnStartup()
 {
-    return m_Oasis_Settings.beepOnStartup==1;
+    Oasis_State state;
+
+    getState(state);
+    return state.beepOnStartup==1;
 }
 
 int COasisController::setBeepOnStartup(bool bEnabled)
 {
-    int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    COasisConfigTransaction config;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBeepOnStartup] setting beep on statrup to :  " << (bEnabled?"True":"False") << std::endl;
-    m_sLogFile.flush();
-#endif
-
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_BEEP_ON_STARTUP);
-    frameConfig.beepOnStartup = bEnabled?1:0;
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
-
-    nErr = sendCommand(cHIDBuffer);
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBeepOnStartup", "setting beep on statrup to :  %s", (bEnabled?"True":"False"));
 
-    return nErr;
+    config.setBeepOnStartup(bEnabled);
+    return commitConfig(config);
 }
 
 bool COasisController::getBluetoothEnabled()
 {
-    return m_Oasis_Settings.bluetoothOn==1;
+    Oasis_State state;
+
+    getState(state);
+    return state.bluetoothOn==1;
 }
 
 int COasisController::setBluetoothEnabled(bool bEnabled)
+{
+    COasisConfigTransaction config;
+
+    if(!m_bIsConnected || !isDeviceOpen())
+        return ERR_COMMNOLINK;
+
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBluetoothEnabled", "setting bluetooth to :  %s", (bEnabled?"Enable":"Disable"));
+
+    config.setBluetoothEnabled(bEnabled);
+    return commitConfig(config);
+}
+
+int COasisController::commitConfig(COasisConfigTransaction &config)
 {
     int nErr = PLUGIN_OK;
     byte cHIDBuffer[REPORT_SIZE];
+    uint32_t nMask;
+
+    config.nSentMask = 0;
+    config.nFailedMask = 0;
+    config.nBluetoothNameErr = PLUGIN_OK;
+    config.nFriendlyNameErr = PLUGIN_OK;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen()) {
+        config.nFailedMask = config.nMask;
+        config.nBluetoothNameErr = config.bSetBluetoothName?ERR_COMMNOLINK:PLUGIN_OK;
+        config.nFriendlyNameErr = config.bSetFriendlyName?ERR_COMMNOLINK:PLUGIN_OK;
         return ERR_COMMNOLINK;
+    }
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBluetoothEnabled] setting bluetooth to :  " << (bEnabled?"Enable":"Disable") << std::endl;
-    m_sLogFile.flush();
-#endif
+    // the elision is only as good as our copy of the config, make sure we have one
+    ensureDeviceInfo(CODE_GET_CONFIG);
+
+    nMask = config.nMask;
+    {
+        const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+        if(m_bGotconfig) {
+            if(config.nMaxStep == m_Oasis_Settings.nMaxPos)                     nMask &= ~MASK_MAX_STEP;
+            if(config.nBacklash == m_Oasis_Settings.backlash)                   nMask &= ~MASK_BACKLASH;
+            if(config.nBacklashDirection == m_Oasis_Settings.backlashDirection) nMask &= ~MASK_BACKLASH_DIRECTION;
+            if(config.bReverse == m_Oasis_Settings.bIsReversed)                 nMask &= ~MASK_REVERSE_DIRECTION;
+            if(config.nSpeed == m_Oasis_Settings.speed)                         nMask &= ~MASK_SPEED;
+            if((config.bBeepOnMove?1:0) == m_Oasis_Settings.beepOnMove)         nMask &= ~MASK_BEEP_ON_MOVE;
+            if((config.bBeepOnStartup?1:0) == m_Oasis_Settings.beepOnStartup)   nMask &= ~MASK_BEEP_ON_STARTUP;
+            if((config.bBluetoothOn?1:0) == m_Oasis_Settings.bluetoothOn)       nMask &= ~MASK_BLUETOOTH;
+        }
+        if(config.bSetBluetoothName && m_bGotBluetoothName && trim(config.sBluetoothName, "\n\r ") == m_Oasis_Settings.sBluetoothName)
+            config.bSetBluetoothName = false;
+        if(config.bSetFriendlyName && m_bGotFriendlyName && trim(config.sFriendlyName, "\n\r ") == m_Oasis_Settings.sFriendlyName)
+            config.bSetFriendlyName = false;
+    }
 
-    DeclareFrame(FrameConfig, frameConfig  , CODE_SET_CONFIG);
-    frameConfig.mask = htonl(MASK_BLUETOOTH);
-    frameConfig.bluetoothOn = bEnabled?1:0;
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameConfig, sizeof(FrameConfig));
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "commitConfig", "requested mask 0x%08X, sending mask 0x%08X", (unsigned int)config.nMask, (unsigned int)nMask);
+
+    config.nSentMask = nMask;
+    if(nMask) {
+        CFrameWriter<FrameConfig> frameConfig(cHIDBuffer, CODE_SET_CONFIG);
+        FrameSet(frameConfig, FrameConfig, mask, nMask);
+        FrameSet(frameConfig, FrameConfig, maxStep, config.nMaxStep);
+        FrameSet(frameConfig, FrameConfig, backlash, config.nBacklash);
+        FrameSet(frameConfig, FrameConfig, backlashDirection, config.nBacklashDirection);
+        FrameSet(frameConfig, FrameConfig, reverseDirection, config.bReverse?1:0);
+        FrameSet(frameConfig, FrameConfig, speed, config.nSpeed);
+        FrameSet(frameConfig, FrameConfig, beepOnMove, config.bBeepOnMove?1:0);
+        FrameSet(frameConfig, FrameConfig, beepOnStartup, config.bBeepOnStartup?1:0);
+        FrameSet(frameConfig, FrameConfig, bluetoothOn, config.bBluetoothOn?1:0);
 
-    nErr = sendCommand(cHIDBuffer);
+        nErr = sendCommand(cHIDBuffer);
+        // one read back to confirm and refresh our copy
+        if(!nErr)
+            nErr = getConfig();
+        if(nErr) {
+            // we lost the link, nothing after this will go through either
+            config.nFailedMask = nMask;
+            config.nBluetoothNameErr = config.bSetBluetoothName?nErr:PLUGIN_OK;
+            config.nFriendlyNameErr = config.bSetFriendlyName?nErr:PLUGIN_OK;
+            return nErr;
+        }
+
+        const std::lock_guard<std::mutex> lock(m_GlobalMutex);
+        if((nMask & MASK_MAX_STEP) && config.nMaxStep != m_Oasis_Settings.nMaxPos)                                      config.nFailedMask |= MASK_MAX_STEP;
+        if((nMask & MASK_BACKLASH) && config.nBacklash != m_Oasis_Settings.backlash)                                    config.nFailedMask |= MASK_BACKLASH;
+        if((nMask & MASK_BACKLASH_DIRECTION) && config.nBacklashDirection != m_Oasis_Settings.backlashDirection)         config.nFailedMask |= MASK_BACKLASH_DIRECTION;
+        if((nMask & MASK_REVERSE_DIRECTION) && config.bReverse != m_Oasis_Settings.bIsReversed)                         config.nFailedMask |= MASK_REVERSE_DIRECTION;
+        if((nMask & MASK_SPEED) && config.nSpeed != m_Oasis_Settings.speed)                                             config.nFailedMask |= MASK_SPEED;
+        if((nMask & MASK_BEEP_ON_MOVE) && (config.bBeepOnMove?1:0) != m_Oasis_Settings.beepOnMove)                      config.nFailedMask |= MASK_BEEP_ON_MOVE;
+        if((nMask & MASK_BEEP_ON_STARTUP) && (config.bBeepOnStartup?1:0) != m_Oasis_Settings.beepOnStartup)             config.nFailedMask |= MASK_BEEP_ON_STARTUP;
+        if((nMask & MASK_BLUETOOTH) && (config.bBluetoothOn?1:0) != m_Oasis_Settings.bluetoothOn)                       config.nFailedMask |= MASK_BLUETOOTH;
+        if(config.nFailedMask) {
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "commitConfig", "ERROR read back doesn't match what was sent, failed mask 0x%08X", (unsigned int)config.nFailedMask);
+            nErr = ERR_CMDFAILED;
+        }
+    }
 
+    // the names have their own frames, a config mismatch doesn't stop them from going out
+    if(config.bSetBluetoothName) {
+        config.nBluetoothNameErr = setBluetoothName(config.sBluetoothName);
+        if(!config.nBluetoothNameErr)
+            config.nBluetoothNameErr = getBluetoothName();
+        if(!nErr)
+            nErr = config.nBluetoothNameErr;
+    }
+    if(config.bSetFriendlyName) {
+        config.nFriendlyNameErr = setFriendlyName(config.sFriendlyName);
+        if(!config.nFriendlyNameErr)
+            config.nFriendlyNameErr = getFriendlyName();
+        if(!nErr)
+            nErr = config.nFriendlyNameErr;
+    }
     return nErr;
 }
 
 void COasisController::getBluetoothName(std::string &sName)
 {
-    sName.assign(m_Oasis_Settings.sBluetoothName);
+    Oasis_State state;
+
+    ensureDeviceInfo(CODE_GET_BLUETOOTH_NAME);
+    getState(state);
+    sName.assign(state.sBluetoothName.c_str());
 }
 
 int COasisController::setBluetoothName(std::string sName)
@@ -982,24 +1936,16 @@ int COasisController::setBluetoothName(std::string sName)
     int nErr = PLUGIN_OK;
     byte cHIDBuffer[REPORT_SIZE];
     std::string sNewName;
-    int nameMaxLen;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setBluetoothName] setting bluetooth name to :  " << sName << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setBluetoothName", "setting bluetooth name to :  %s", sName.c_str());
 
     sNewName = trim(sName,"\n\r ");
 
-    DeclareFrame(FrameBluetoothName, command, CODE_SET_BLUETOOTH_NAME);
-    nameMaxLen = sizeof(command.data);
-    memcpy(command.data, sNewName.c_str(),nameMaxLen<sNewName.size()?nameMaxLen:sNewName.size());
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&command, sizeof(FrameBluetoothName));
+    CFrameWriter<FrameBluetoothName> command(cHIDBuffer, CODE_SET_BLUETOOTH_NAME);
+    FrameSetBytes(command, FrameBluetoothName, data, sNewName.c_str(), sNewName.size());
 
     nErr = sendCommand(cHIDBuffer);
 
@@ -1008,7 +1954,11 @@ int COasisController::setBluetoothName(std::string sName)
 
 void COasisController::getFriendlyName(std::string &sName)
 {
-    sName.assign(m_Oasis_Settings.sFriendlyName);
+    Oasis_State state;
+
+    ensureDeviceInfo(CODE_GET_FRIENDLY_NAME);
+    getState(state);
+    sName.assign(state.sFriendlyName.c_str());
 }
 
 int COasisController::setFriendlyName(std::string sName)
@@ -1016,24 +1966,16 @@ int COasisController::setFriendlyName(std::string sName)
     int nErr = PLUGIN_OK;
     byte cHIDBuffer[REPORT_SIZE];
     std::string sNewName;
-    int nameMaxLen;
 
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setFriendlyName] setting friendly name to :  " << sName << std::endl;
-    m_sLogFile.flush();
-#endif
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "setFriendlyName", "setting friendly name to :  %s", sName.c_str());
 
     sNewName = trim(sName,"\n\r ");
 
-    DeclareFrame(FrameBluetoothName, command, CODE_SET_FRIENDLY_NAME);
-    nameMaxLen = sizeof(command.data);
-    memcpy(command.data, sNewName.c_str(),nameMaxLen<sNewName.size()?nameMaxLen:sNewName.size());
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&command, sizeof(FrameBluetoothName));
+    CFrameWriter<FrameFriendlyName> command(cHIDBuffer, CODE_SET_FRIENDLY_NAME);
+    FrameSetBytes(command, FrameFriendlyName, data, sNewName.c_str(), sNewName.size());
 
     nErr = sendCommand(cHIDBuffer);
 
@@ -1045,21 +1987,20 @@ int COasisController::setFriendlyName(std::string sName)
 
 void COasisController::getSerial(std::string &sSerial)
 {
-    sSerial.assign(m_Oasis_Settings.sSerial);
+    Oasis_State state;
+
+    getState(state);
+    sSerial.assign(state.sSerial.c_str());
 }
 
 void COasisController::getFirmwareVersion(std::string &sFirmware)
 {
-    sFirmware.clear();
-    if(m_GlobalMutex.try_lock()) {
-        if(m_Oasis_Settings.sVersion.size()) {
-            sFirmware.assign(m_Oasis_Settings.sVersion);
-        }
-        else {
-            sFirmware = "NA";
-        }
-        m_GlobalMutex.unlock();
-    }
+    Oasis_State state;
+
+    ensureDeviceInfo(CODE_GET_VERSION);
+    getState(state);
+    if(state.sVersion.size())
+        sFirmware.assign(state.sVersion.c_str());
     else
         sFirmware = "NA";
 
@@ -1068,80 +2009,79 @@ void COasisController::getFirmwareVersion(std::string &sFirmware)
 double COasisController::getTemperature()
 {
     // need to allow user to select the focuser temp source
-    switch(m_nTempSource) {
-        case INTERNAL:
-            return m_Oasis_Settings.fInternal;
-            break;
-        case EXTERNAL:
-            return m_Oasis_Settings.fAmbient;
-            break;
-        default:
-            return m_Oasis_Settings.fInternal;
-            break;
-    }
+    return getTemperature(m_nTempSource);
 }
 
 double COasisController::getTemperature(int nSource)
 {
+    Oasis_State state;
+
+    getState(state);
     switch(nSource) {
         case INTERNAL:
-            return m_Oasis_Settings.fInternal;
+            return state.fInternal;
             break;
         case EXTERNAL:
-            return m_Oasis_Settings.fAmbient;
+            return state.fAmbient;
             break;
         default:
-            return m_Oasis_Settings.fInternal;
+            return state.fInternal;
             break;
     }
 }
 
 bool COasisController::isExternalSensorPresent()
 {
-    return  m_Oasis_Settings.bExternalSensorPresent;
+    Oasis_State state;
 
+    getState(state);
+    return state.bExternalSensorPresent;
 }
 
 uint32_t COasisController::getPosition()
 {
+    Oasis_State state;
 
-    if(m_Oasis_Settings.nCurPos < 0)
-       return 0;
-    return m_Oasis_Settings.nCurPos;
+    getState(state);
+    return state.nCurPos;
 }
 
 int COasisController::setPosition(unsigned int nPos)
 {
     int nErr = PLUGIN_OK;
-    byte cHIDBuffer[REPORT_SIZE];
+    CommandToken token;
 
-    DeclareFrame(FrameSyncPosition, frameSync, CODE_CMD_SYNC_POSITION);
-
-    if(!m_bIsConnected || !m_DevHandle)
+    if(!m_bIsConnected || !isDeviceOpen())
         return ERR_COMMNOLINK;
 
     if(m_Oasis_Settings.bIsMoving)
         return ERR_CMD_IN_PROGRESS_FOC;
 
-    frameSync.position = htonl((unsigned int)nPos);
-    // clear buffer and set cHIDBuffer[0] to report ID 0
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-    memcpy(cHIDBuffer+1, (byte*)&frameSync, sizeof(FrameMoveTo));
+    nErr = queueSyncPosition(nPos, token);
+    if(!nErr)
+        nErr = waitForReply(token);
 
+    return nErr;
+}
 
-#ifdef PLUGIN_DEBUG
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [setPosition] set to :  " << std::dec << nPos << " (0x" << std::uppercase << std::setfill('0') << std::setw(4) << std::hex << nPos <<")" << std::dec << std::endl;
-    m_sLogFile.flush();
-#endif
+int COasisController::queueSyncPosition(unsigned int nPos, CommandToken &token)
+{
+    byte cHIDBuffer[REPORT_SIZE];
 
-    nErr = sendCommand(cHIDBuffer);
+    CFrameWriter<FrameSyncPosition> frameSync(cHIDBuffer, CODE_CMD_SYNC_POSITION);
+    FrameSet(frameSync, FrameSyncPosition, position, nPos);
 
-    return nErr;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "queueSyncPosition", "set to :  %d (0x%04X)", (int)nPos, (unsigned int)nPos);
+
+    return sendCommandAsync(cHIDBuffer, token);
 }
 
 uint32_t COasisController::getPosLimit()
 {
-    return m_Oasis_Settings.nMaxPos;
+    Oasis_State state;
+
+    getState(state);
+    return state.nMaxPos;
 }
 
 
@@ -1156,358 +2096,287 @@ int COasisController::getTemperatureSource()
 
 }
 
-#pragma mark command and response functions
-
+#pragma mark frame handlers
 
-void COasisController::parseResponse(byte *Buffer, int nLength)
+// built at compile time, codes without a handler are plain acks
+constexpr std::array<COasisController::FrameHandler, FRAME_CODES> COasisController::defaultFrameHandlers()
 {
+    std::array<FrameHandler, FRAME_CODES> handlers {};
+
+    handlers[CODE_GET_PRODUCT_MODEL] = &memberFrameHandler<&COasisController::onProductModel>;
+    handlers[CODE_GET_VERSION] = &memberFrameHandler<&COasisController::onVersion>;
+    handlers[CODE_GET_FRIENDLY_NAME] = &memberFrameHandler<&COasisController::onFriendlyName>;
+    handlers[CODE_GET_BLUETOOTH_NAME] = &memberFrameHandler<&COasisController::onBluetoothName>;
+    handlers[CODE_GET_CONFIG] = &memberFrameHandler<&COasisController::onConfig>;
+    handlers[CODE_GET_STATUS] = &memberFrameHandler<&COasisController::onStatus>;
+    return handlers;
+}
 
-    // locking the mutex to prevent access while we're accessing to the data.
-    const std::lock_guard<std::mutex> lock(m_GlobalMutex);
-    int temperatureExt;
-    byte nCode;
-    FrameConfig *fConfig;
-    FrameStatusAck *fStatus;
-    FrameVersionAck *fVersions;
-    FrameSerialNumber *fSerial;
-    FrameProductModelAck *fModel;
-    FrameFriendlyName *fFriendlyName;
-    FrameBluetoothName *fBluetoothName;
-
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    hexdump(Buffer,  nLength, m_hexOut);
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] Buffer size " << std::dec << nLength <<", content : " << std::endl << m_hexOut << std::endl;
-    m_sLogFile.flush();
-#endif
-    nCode = Buffer[0];
-    switch (nCode) {
-        case  CODE_GET_PRODUCT_MODEL :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_PRODUCT_MODEL" << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_bGotModel = true;
-            fModel = (FrameProductModelAck*)Buffer;
-            m_Oasis_Settings.sModel.assign((char*)fModel->data);
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_PRODUCT_MODEL fModel->data  '" << fModel->data <<"'"<< std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_PRODUCT_MODEL m_Oasis_Settings.sModel '" << m_Oasis_Settings.sModel <<"'"<< std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_GET_VERSION :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION" << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_bGotVersion = true;
-            fVersions = (FrameVersionAck *)Buffer;
-            m_Oasis_Settings.sVersion.assign(std::to_string((ntohl(fVersions->firmware & 0xFF000000))>>24) + "." +
-            std::to_string((fVersions->firmware & 0x00FF0000)>>16) + "." +
-            std::to_string((fVersions->firmware & 0x0000FF00)>>8) + "." +
-            std::to_string((fVersions->firmware & 0x000000FF))+ " " + fVersions->built) ;
-
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION FrameVersionAck fVersions->protocal         = " << std::setfill('0') << std::setw(8) << std::hex << (fVersions->protocal) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION FrameVersionAck fVersions->hardware         = " << std::setfill('0') << std::setw(8) << std::hex << (fVersions->hardware) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION FrameVersionAck fVersions->firmware         = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fVersions->firmware) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION FrameVersionAck fVersions->built            = " << fVersions->built << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_VERSION FrameVersionAck m_Oasis_Settings.sVersion   = " << m_Oasis_Settings.sVersion << std::endl;
-            m_sLogFile.flush();
-#endif
-
-            break;
-
-        case  CODE_GET_SERIAL_NUMBER :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_SERIAL_NUMBER" << std::endl;
-            m_sLogFile.flush();
-#endif
-            fSerial = (FrameSerialNumber*)Buffer;
-            // m_Oasis_Settings.sSerial.assign((char*)(fSerial->data), FRAME_NAME_LEN);
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_SERIAL_NUMBER FrameSerialNumberAck fSerial->data = " << fSerial->data << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_SERIAL_NUMBER We're not using this." << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_GET_FRIENDLY_NAME :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_FRIENDLY_NAME" << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_bGotFriendlyName= true;
-            fFriendlyName = (FrameFriendlyName*)Buffer;
-            m_Oasis_Settings.sFriendlyName.assign((char*)(fFriendlyName->data));
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_FRIENDLY_NAME fFriendlyName->data            '" << fFriendlyName->data <<"'"<< std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_FRIENDLY_NAME m_Oasis_Settings.sFriendlyName '" << m_Oasis_Settings.sFriendlyName <<"'"<< std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_SET_FRIENDLY_NAME :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_SET_FRIENDLY_NAME" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_GET_BLUETOOTH_NAME :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_BLUETOOTH_NAME" << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_bGotBluetoothName = true;
-            fBluetoothName = (FrameBluetoothName*)Buffer;
-            m_Oasis_Settings.sBluetoothName.assign((char*)(fBluetoothName->data));
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_BLUETOOTH_NAMEfBluetoothName->data             '" << fBluetoothName->data << "'" << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_BLUETOOTH_NAME m_Oasis_Settings.sBluetoothName '" << m_Oasis_Settings.sBluetoothName << "'" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_SET_BLUETOOTH_NAME :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_SET_BLUETOOTH_NAME" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
-
-        case  CODE_GET_USER_ID :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_USER_ID" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+const std::array<COasisController::FrameHandler, FRAME_CODES> COasisController::DefaultFrameHandlers = COasisController::defaultFrameHandlers();
 
-        case  CODE_SET_USER_ID :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_SET_USER_ID" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+// a null pHandler removes the code's handler, its frames become plain acks again
+int COasisController::registerFrameHandler(byte nCode, FrameHandler pHandler, void *pContext)
+{
+    FrameHandlerEntry &entry = m_FrameHandlers[nCode];
 
-        case  CODE_CMD_UPGRADE :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_UPGRADE" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    // the parser thread reads the table without a lock, it only changes while disconnected
+    if(m_bIsConnected)
+        return ERR_CMDFAILED;
 
-        case  CODE_CMD_UPGRADE_BOOTLOADER :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_UPGRADE_BOOTLOADER" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    if(pHandler && entry.pHandler && (entry.pHandler != pHandler || entry.pContext != pContext)) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "registerFrameHandler", "code 0x%02X already has a handler", (int)nCode);
+        return ERR_CMDFAILED;
+    }
 
-        case  CODE_GET_CONFIG :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG" << std::endl;
-            m_sLogFile.flush();
-#endif
-            m_bGotconfig = true;
-            fConfig = (FrameConfig*)Buffer;
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->mask              = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fConfig->mask) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->maxStep           = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fConfig->maxStep) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->backlash          = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fConfig->backlash) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->backlashDirection = " << std::dec << (fConfig->backlashDirection==0?0:1) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->reverseDirection  = " << std::dec << (fConfig->reverseDirection==0?0:1) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->speed             = " << std::dec << std::to_string(fConfig->speed) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->beepOnMove        = " << std::dec << (fConfig->beepOnMove==0?0:1) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->beepOnStartup     = " << std::hex << (fConfig->beepOnStartup==0?0:1) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_CONFIG FrameConfig fConfig->bluetoothOn       = " << std::hex << (fConfig->bluetoothOn==0?0:1) << std::endl;
-            m_sLogFile.flush();
-#endif
+    entry.pHandler = pHandler;
+    entry.pContext = pHandler ? pContext : nullptr;
+    return PLUGIN_OK;
+}
 
-            m_Oasis_Settings.nMaxPos = ntohl(fConfig->maxStep);
-            m_Oasis_Settings.bIsReversed = fConfig->reverseDirection;
-            m_Oasis_Settings.backlash = ntohl(fConfig->backlash);
-            m_Oasis_Settings.backlashDirection = fConfig->backlashDirection;
-            m_Oasis_Settings.speed = fConfig->speed;
-            m_Oasis_Settings.beepOnMove = fConfig->beepOnMove;
-            m_Oasis_Settings.beepOnStartup = fConfig->beepOnStartup;
-            m_Oasis_Settings.bluetoothOn = fConfig->bluetoothOn;
-            break;
+bool COasisController::onProductModel(const byte *Buffer, int nLength)
+{
+    CFrameView<FrameProductModelAck, sizeof(FrameHead)> fModel(Buffer, nLength);
+    const char *pData;
+    size_t nDataLen;
+
+    if(!fModel.valid())
+        return false;
+
+    m_bGotModel = true;
+    pData = FrameBytes(fModel, FrameProductModelAck, data, nDataLen);
+    m_Oasis_Settings.sModel.assign(pData, nDataLen);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onProductModel", "m_Oasis_Settings.sModel '%s'", m_Oasis_Settings.sModel.c_str());
+    return true;
+}
 
-        case  CODE_SET_CONFIG :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_SET_CONFIG received" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+bool COasisController::onVersion(const byte *Buffer, int nLength)
+{
+    // the build string is optional, the version numbers aren't
+    CFrameView<FrameVersionAck, offsetof(FrameVersionAck, built)> fVersions(Buffer, nLength);
+    unsigned int nFirmware;
+    const char *pData;
+    size_t nDataLen;
+
+    if(!fVersions.valid())
+        return false;
+
+    m_bGotVersion = true;
+    m_bLiveVersion = true;
+    nFirmware = FrameGet(fVersions, FrameVersionAck, firmware);
+    pData = FrameBytes(fVersions, FrameVersionAck, built, nDataLen);
+    // formatted in place, no allocation on this path. major.minor.patch.build, most significant byte first on the wire.
+    snprintf(m_Oasis_Settings.sVersion.buffer(), STATE_VERSION_LEN+1, "%u.%u.%u.%u %.*s",
+             nFirmware>>24, (nFirmware>>16) & 0xFF, (nFirmware>>8) & 0xFF, nFirmware & 0xFF,
+             (int)strnlen(pData, nDataLen), pData);
+    m_Oasis_Settings.sVersion.update();
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onVersion", "FrameVersionAck protocal         = %08X", FrameGet(fVersions, FrameVersionAck, protocal));
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onVersion", "FrameVersionAck hardware         = %08X", FrameGet(fVersions, FrameVersionAck, hardware));
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onVersion", "FrameVersionAck firmware         = %08X", (unsigned int)nFirmware);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onVersion", "FrameVersionAck built            = %.*s", (int)strnlen(pData, nDataLen), pData);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onVersion", "m_Oasis_Settings.sVersion        = %s", m_Oasis_Settings.sVersion.c_str());
+
+    if(m_bHaveDeviceCache && m_Oasis_Settings.sVersion != m_DeviceCache.sVersion) {
+        // new firmware, the cached identity can't be trusted. The verification replies are already
+        // on their way, make the getters wait for them.
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "onVersion", "firmware changed from %s to %s, dropping cached device info", m_DeviceCache.sVersion.c_str(), m_Oasis_Settings.sVersion.c_str());
+        m_bHaveDeviceCache = false;
+        m_bGotModel = false;
+        m_bGotBluetoothName = false;
+        m_bGotFriendlyName = false;
+    }
+    return true;
+}
 
-        case  CODE_GET_STATUS :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS" << std::endl;
-            m_sLogFile.flush();
-#endif
-            fStatus = (FrameStatusAck *)Buffer;
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS FrameStatusAck fStatus->position             = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fStatus->position) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS FrameStatusAck fStatus->temperatureInt       = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fStatus->temperatureInt) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS FrameStatusAck fStatus->temperatureExt       = " << std::setfill('0') << std::setw(8) << std::hex << ntohl(fStatus->temperatureExt) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS FrameStatusAck fStatus->temperatureDetection = " << std::dec << std::to_string(fStatus->temperatureDetection) << std::endl;
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_STATUS FrameStatusAck fStatus->moving               = " << std::dec << std::to_string(fStatus->moving) << std::endl;
-            m_sLogFile.flush();
-#endif
+bool COasisController::onFriendlyName(const byte *Buffer, int nLength)
+{
+    CFrameView<FrameFriendlyName, sizeof(FrameHead)> fFriendlyName(Buffer, nLength);
+    const char *pData;
+    size_t nDataLen;
+
+    if(!fFriendlyName.valid())
+        return false;
+
+    m_bGotFriendlyName= true;
+    pData = FrameBytes(fFriendlyName, FrameFriendlyName, data, nDataLen);
+    m_Oasis_Settings.sFriendlyName.assign(pData, nDataLen);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onFriendlyName", "m_Oasis_Settings.sFriendlyName '%s'", m_Oasis_Settings.sFriendlyName.c_str());
+    return true;
+}
 
-            m_Oasis_Settings.bIsMoving = (fStatus->moving==0?false:true);
-            m_Oasis_Settings.nCurPos = ntohl(fStatus->position);
-            m_Oasis_Settings.fInternal = GetNTCTemperature(ntohl(fStatus->temperatureInt)) * 0.01;
-            if(fStatus->temperatureDetection == 1) {//external probe present
-                m_Oasis_Settings.bExternalSensorPresent = true;
-                temperatureExt = ntohl(fStatus->temperatureExt);
-                temperatureExt = (int)(short)(temperatureExt & 0xFFFF);
-                m_Oasis_Settings.fAmbient =  (temperatureExt * 0.0625f * 100 + 0.5) * 0.01;
-            }
-            else
-                m_Oasis_Settings.bExternalSensorPresent = false;
+bool COasisController::onBluetoothName(const byte *Buffer, int nLength)
+{
+    CFrameView<FrameBluetoothName, sizeof(FrameHead)> fBluetoothName(Buffer, nLength);
+    const char *pData;
+    size_t nDataLen;
+
+    if(!fBluetoothName.valid())
+        return false;
+
+    m_bGotBluetoothName = true;
+    pData = FrameBytes(fBluetoothName, FrameBluetoothName, data, nDataLen);
+    m_Oasis_Settings.sBluetoothName.assign(pData, nDataLen);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onBluetoothName", "m_Oasis_Settings.sBluetoothName '%s'", m_Oasis_Settings.sBluetoothName.c_str());
+    return true;
+}
 
-            break;
+bool COasisController::onConfig(const byte *Buffer, int nLength)
+{
+    CFrameView<FrameConfig> fConfig(Buffer, nLength);
+
+    if(!fConfig.valid())
+        return false;
+
+    m_bGotconfig = true;
+    m_bLiveConfig = true;
+    m_Oasis_Settings.nMaxPos = FrameGet(fConfig, FrameConfig, maxStep);
+    m_Oasis_Settings.bIsReversed = FrameGet(fConfig, FrameConfig, reverseDirection);
+    m_Oasis_Settings.backlash = FrameGet(fConfig, FrameConfig, backlash);
+    m_Oasis_Settings.backlashDirection = FrameGet(fConfig, FrameConfig, backlashDirection);
+    m_Oasis_Settings.speed = FrameGet(fConfig, FrameConfig, speed);
+    m_Oasis_Settings.beepOnMove = FrameGet(fConfig, FrameConfig, beepOnMove);
+    m_Oasis_Settings.beepOnStartup = FrameGet(fConfig, FrameConfig, beepOnStartup);
+    m_Oasis_Settings.bluetoothOn = FrameGet(fConfig, FrameConfig, bluetoothOn);
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onConfig", "mask %08X, max %u, backlash %u %s, reverse %d, speed %d, beep on move %d, beep on startup %d, bluetooth %d",
+             FrameGet(fConfig, FrameConfig, mask), (unsigned int)m_Oasis_Settings.nMaxPos, (unsigned int)m_Oasis_Settings.backlash,
+             (m_Oasis_Settings.backlashDirection==0?"in":"out"), (int)(m_Oasis_Settings.bIsReversed?1:0), (int)m_Oasis_Settings.speed,
+             (int)(m_Oasis_Settings.beepOnMove==0?0:1), (int)(m_Oasis_Settings.beepOnStartup==0?0:1), (int)(m_Oasis_Settings.bluetoothOn==0?0:1));
+    return true;
+}
 
-        case  CODE_CMD_FACTORY_RESET :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_FACTORY_RESET" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+bool COasisController::onStatus(const byte *Buffer, int nLength)
+{
+    CFrameView<FrameStatusAck> fStatus(Buffer, nLength);
+    int temperatureExt;
 
-        case  CODE_SET_ZERO_POSITION :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_SET_ZERO_POSITION" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    if(!fStatus.valid())
+        return false;
+
+    m_bStatusPending = false;
+    m_bGotStatus = true;
+    m_Oasis_Settings.bIsMoving = (FrameGet(fStatus, FrameStatusAck, moving)==0?false:true);
+    m_Oasis_Settings.nCurPos = FrameGet(fStatus, FrameStatusAck, position);
+    m_Oasis_Settings.fInternal = GetNTCTemperature(FrameGet(fStatus, FrameStatusAck, temperatureInt)) * 0.01;
+    if(FrameGet(fStatus, FrameStatusAck, temperatureDetection) == 1) {//external probe present
+        m_Oasis_Settings.bExternalSensorPresent = true;
+        temperatureExt = (int)(short)(FrameGet(fStatus, FrameStatusAck, temperatureExt) & 0xFFFF);
+        m_Oasis_Settings.fAmbient =  (temperatureExt * 0.0625f * 100 + 0.5) * 0.01;
+    }
+    else
+        m_Oasis_Settings.bExternalSensorPresent = false;
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "onStatus", "position %u, moving %d, internal %.2f C (ADC %u), external %s %.2f C",
+             (unsigned int)m_Oasis_Settings.nCurPos, (int)(m_Oasis_Settings.bIsMoving?1:0), (double)m_Oasis_Settings.fInternal,
+             (unsigned int)FrameGet(fStatus, FrameStatusAck, temperatureInt), (m_Oasis_Settings.bExternalSensorPresent?"present":"absent"),
+             (double)m_Oasis_Settings.fAmbient);
+    return true;
+}
 
-        case  CODE_CMD_MOVE_STEP :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_MOVE_STEP" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+#pragma mark command and response functions
 
-        case  CODE_CMD_MOVE_TO :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_MOVE_TO" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
 
-        case  CODE_CMD_STOP_MOVE :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_GET_PRODUCT_MODEL" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+void COasisController::parseResponse(byte *Buffer, int nLength)
+{
+    byte nCode;
+    const FrameHandlerEntry *pEntry;
 
-        case  CODE_CMD_SYNC_POSITION :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] CODE_CMD_SYNC_POSITION" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    OasisLogHex(m_Logger, LOG_LEVEL_DEBUG, "parseResponse", Buffer, nLength, "Buffer size %d, content :", nLength);
+    if(nLength < 1)
+        return;
 
-        default :
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-            m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] PLUGIN_DEBUG" << std::endl;
-            m_sLogFile.flush();
-#endif
-            break;
+    nCode = Buffer[0];
+    pEntry = &m_FrameHandlers[nCode];
+    if(!pEntry->pHandler) {
+        // plain ack, there is nothing to store so we don't need the lock
+        OasisLog(m_Logger, LOG_LEVEL_DEBUG, "parseResponse", "ack for code 0x%02X", (int)nCode);
+        completeReply(nCode);
+        return;
     }
 
+    {
+        // locking the mutex to prevent access while we're accessing to the data.
+        const std::lock_guard<std::mutex> lock(m_GlobalMutex);
 
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.nCurPos             : " << std::dec << m_Oasis_Settings.nCurPos << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.nMaxPos             : " << std::dec << m_Oasis_Settings.nMaxPos << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.bIsMoving           : " << ( m_Oasis_Settings.bIsMoving ?"Yes":"No") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.bIsReversed         : " << ( m_Oasis_Settings.bIsReversed ?"Yes":"No") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.sVersion            : " << m_Oasis_Settings.sVersion << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.sModel              : " << m_Oasis_Settings.sModel << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.sSerial             : " << m_Oasis_Settings.sSerial << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.nBackstep           : " << std::dec << m_Oasis_Settings.nBackstep << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.nBacklash           : " << std::dec << m_Oasis_Settings.nCurPos << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.fInternal           : " << m_Oasis_Settings.fInternal << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.fAmbient            : " << m_Oasis_Settings.fAmbient << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.backlash            : " << std::to_string(m_Oasis_Settings.backlash) << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.backlashDirection   : " << (m_Oasis_Settings.backlashDirection==0?"In":"Out") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.speed               : " << std::to_string(m_Oasis_Settings.speed) << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.beepOnStartup       : " << (m_Oasis_Settings.beepOnStartup==1?"Enable":"Disable") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.beepOnMove          : " << (m_Oasis_Settings.beepOnMove==1?"Enable":"Disable") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.bluetoothOn         : " << (m_Oasis_Settings.bluetoothOn==1?"On":"Off") << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.sBluetoothName      : " <<  m_Oasis_Settings.sBluetoothName << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [parseResponse] m_Oasis_Settings.sFriendlyName       : " <<  m_Oasis_Settings.sFriendlyName << std::endl;
-    m_sLogFile.flush();
-#endif
-
+        if(!pEntry->pHandler(pEntry->pContext, Buffer, nLength)) {
+            // the waiter times out and retries like it would for a lost reply
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "parseResponse", "dropping malformed frame, code 0x%02X len %d, read %d", (int)nCode, (int)(nLength>1?(int)Buffer[1]:-1), (int)nLength);
+            return;
+        }
 
+        // readers see the new values before anyone waiting on this reply is released
+        publishState();
+    }
+    completeReply(nCode);
 }
 
+#pragma mark - NTC conversion
 
-int COasisController::sendSettings()
+// natural log for the constexpr table, std::log isn't constexpr before C++26.
+// Reduce to [1/sqrt(2), sqrt(2)] and sum the atanh series, more than enough for a float result.
+static constexpr double ntcLn(double x)
 {
-    int nErr = PLUGIN_OK;
-    int nByteWriten = 0;
-    byte cHIDBuffer[REPORT_SIZE];
-    int nNbTimeOut = 0;
-
-    if(!m_bIsConnected)
-        return ERR_COMMNOLINK;
-
-    if(!m_DevHandle)
-        return ERR_COMMNOLINK;
-
-    memset(cHIDBuffer, 0, REPORT_SIZE);
-
-    return nErr;
-
-    // TO REWRITE
-
-    nErr = sendCommand(cHIDBuffer);
-    return nErr;
+    int nExp = 0;
+    while(x > 1.4142135623730951) {
+        x *= 0.5;
+        nExp++;
+    }
+    while(x < 0.7071067811865476) {
+        x *= 2.0;
+        nExp--;
+    }
+    const double s = (x - 1.0) / (x + 1.0);
+    const double s2 = s * s;
+    double term = s;
+    double sum = 0.0;
+    for(int k = 1; term > 1e-18 || term < -1e-18; k += 2) {
+        sum += term / k;
+        term *= s2;
+    }
+    return 2.0 * sum + nExp * 0.69314718055994530942;
 }
 
-int COasisController::GetNTCTemperature(int ad)
+// same steps and float precision as the old runtime formula, only logf is replaced
+static constexpr int ntcCentiDegrees(int ad)
 {
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] ad = " << ad << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] AD_MAX = " << AD_MAX << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] B = " << B << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] T25 = " << T25 << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] K = " << K << std::endl;
-    m_sLogFile.flush();
-#endif
-
     if (ad <= 0)
         ad = 1;
     else if (ad >= AD_MAX)
         ad = AD_MAX - 1;
 
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] after boundary check ad = " << ad << std::endl;
-    m_sLogFile.flush();
-#endif
+    float T = (float)(B / ((float)ntcLn((AD_MAX - ad) / (float)ad) + B / T25) - K);
+    T += (T >= 0) ? 0.005f : -0.005f;
+    return (int)(T * 100);
+}
 
-    float T = (float)(B / (log((AD_MAX - ad) / (float)ad) + B / T25) - K);
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] T = " << T << std::endl;
-    m_sLogFile.flush();
-#endif
+// built in blocks so each one stays within the compilers' default constexpr evaluation limits
+template <int FIRST>
+struct CNtcBlock {
+    static constexpr std::array<int, NTC_BLOCK_SIZE> build()
+    {
+        std::array<int, NTC_BLOCK_SIZE> values{};
+        for(int i = 0; i < NTC_BLOCK_SIZE; i++)
+            values[i] = ntcCentiDegrees(FIRST + i);
+        return values;
+    }
+    static constexpr std::array<int, NTC_BLOCK_SIZE> values = build();
+};
 
-    T += (T >= 0) ? 0.005f : -0.005f;
+static constexpr const int *NtcTable[(AD_MAX + 1) / NTC_BLOCK_SIZE] = {
+    CNtcBlock<0x000>::values.data(), CNtcBlock<0x100>::values.data(), CNtcBlock<0x200>::values.data(), CNtcBlock<0x300>::values.data(),
+    CNtcBlock<0x400>::values.data(), CNtcBlock<0x500>::values.data(), CNtcBlock<0x600>::values.data(), CNtcBlock<0x700>::values.data(),
+    CNtcBlock<0x800>::values.data(), CNtcBlock<0x900>::values.data(), CNtcBlock<0xA00>::values.data(), CNtcBlock<0xB00>::values.data(),
+    CNtcBlock<0xC00>::values.data(), CNtcBlock<0xD00>::values.data(), CNtcBlock<0xE00>::values.data(), CNtcBlock<0xF00>::values.data(),
+};
+static_assert(sizeof(NtcTable) / sizeof(NtcTable[0]) * NTC_BLOCK_SIZE == AD_MAX + 1, "NTC table must cover every ADC value");
 
-#if defined PLUGIN_DEBUG && PLUGIN_DEBUG >= 3
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature] adjusted T = " << T << std::endl;
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [GetNTCTemperature]  T *100 = " << T*100 << std::endl;
-    m_sLogFile.flush();
-#endif
+int COasisController::GetNTCTemperature(int ad)
+{
+    if (ad <= 0)
+        ad = 1;
+    else if (ad >= AD_MAX)
+        ad = AD_MAX - 1;
 
-    return (int)(T * 100);
+    // the table holds the result of the formula for every ADC value, see ntcCentiDegrees.
+    // onStatus logs the ADC value along with the temperature, nothing to add on this path.
+    return NtcTable[ad / NTC_BLOCK_SIZE][ad % NTC_BLOCK_SIZE];
 }
 
 std::string& COasisController::trim(std::string &str, const std::string& filter )
@@ -1527,36 +2396,16 @@ std::string& COasisController::rtrim(std::string& str, const std::string& filter
     return str;
 }
 
-#ifdef PLUGIN_DEBUG
-void  COasisController::hexdump(const byte *inputData, int inputSize,  std::string &outHex)
-{
-    int idx=0;
-    std::stringstream ssTmp;
-
-    outHex.clear();
-    for(idx=0; idx<inputSize; idx++){
-        if((idx%16) == 0 && idx>0)
-            ssTmp << std::endl;
-        ssTmp << "0x" << std::uppercase << std::setfill('0') << std::setw(2) << std::hex << (int)inputData[idx] <<" ";
-    }
-    outHex.assign(ssTmp.str());
-}
-
-void COasisController::logToFile(const std::string sLogLine)
+void COasisController::setLogLevel(int nLevel)
 {
-    m_sLogFile << "["<<getTimeStamp()<<"]"<< " [log] " << sLogLine << std::endl;
-    m_sLogFile.flush();
+    int nPrevious = m_Logger.getLevel();
 
+    m_Logger.setLevel(nLevel);
+    if(nPrevious == LOG_LEVEL_OFF)
+        logBanner();
 }
 
-const std::string COasisController::getTimeStamp()
+void COasisController::logBanner()
 {
-    time_t     now = time(0);
-    struct tm  tstruct;
-    char       buf[80];
-    tstruct = *localtime(&now);
-    std::strftime(buf, sizeof(buf), "%Y-%m-%d.%X", &tstruct);
-
-    return buf;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "COasisController", "Version %.2f build %s %s on %s", PLUGIN_VERSION, __DATE__, __TIME__, m_sPlatform.c_str());
 }
-#endif
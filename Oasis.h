@@ -18,6 +18,30 @@
 #endif
 #ifdef SB_LINUX_BUILD
 #include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+
+// libudev is already pulled in by hidapi-hidraw, only declare the few monitor calls we use
+// so the build doesn't need the libudev headers.
+extern "C" {
+    struct udev;
+    struct udev_monitor;
+    struct udev_device;
+    struct udev *udev_new(void);
+    struct udev *udev_unref(struct udev *udev);
+    struct udev_monitor *udev_monitor_new_from_netlink(struct udev *udev, const char *name);
+    int udev_monitor_filter_add_match_subsystem_devtype(struct udev_monitor *udev_monitor, const char *subsystem, const char *devtype);
+    int udev_monitor_enable_receiving(struct udev_monitor *udev_monitor);
+    int udev_monitor_get_fd(struct udev_monitor *udev_monitor);
+    struct udev_device *udev_monitor_receive_device(struct udev_monitor *udev_monitor);
+    struct udev_monitor *udev_monitor_unref(struct udev_monitor *udev_monitor);
+    const char *udev_device_get_action(struct udev_device *udev_device);
+    struct udev_device *udev_device_unref(struct udev_device *udev_device);
+}
 #endif
 #ifdef SB_WIN_BUILD
 #include <winsock.h>
@@ -30,26 +54,68 @@
 #include <future>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <thread>
 #include <iomanip>
 #include <fstream>
+#include <array>
 
 #include "../../licensedinterfaces/sberrorx.h"
 
 #include "hidapi.h"
 #include "StopWatch.h"
+#include "MpscQueue.h"
+#include "SpscRing.h"
+#include "SeqLock.h"
+#include "InlineString.h"
 #include "protocol.h"
+#include "FrameCodec.h"
+#include "OasisLogger.h"
+#include "FrameTrace.h"
+#include "OasisTransport.h"
+#include "OasisSimulator.h"
+#include "OasisFaultTransport.h"
 
 #define PLUGIN_VERSION      1.0
 
 // #define PLUGIN_DEBUG 3
 
+// logging is always built in, this is the level used until the ini setting is applied
+#ifdef PLUGIN_DEBUG
+#define LOG_DEFAULT_LEVEL   PLUGIN_DEBUG
+#else
+#define LOG_DEFAULT_LEVEL   LOG_LEVEL_OFF
+#endif
+
 #define MAX_TIMEOUT         10
 #define REPORT_SIZE         65 // 64 byte buffer + report ID
 #define MAX_GOTO_RETRY      3   // 3 retiries on goto if the focuser didn't move
-
-#define VENDOR_ID           0x338f
-#define PRODUCT_ID          0xa0f0
+#define MAX_HALT_RETRY      3   // stop commands sent before haltFocuser gives up
+#define CMD_REPLY_TIMEOUT   500 // ms, default deadline for a command reply
+#define CMD_RETRY_DELAY     10  // ms, delay between write retries
+#define CONNECT_TIMEOUT     1000 // ms, shared deadline for all the connect queries
+#define CONNECT_RESEND_INTERVAL 250 // ms, re-send the queries that are still unanswered
+#define METADATA_TIMEOUT    500 // ms, how long a getter waits for metadata that wasn't fetched yet
+#define STATUS_POLL_FAST    100     // ms, status polling interval while moving
+#define STATUS_POLL_IDLE_MIN 250    // ms, first idle interval after a move
+#define STATUS_POLL_IDLE_MAX 2000   // ms, idle back off limit
+#define STATUS_REPLY_TIMEOUT 500    // ms, after this an unanswered status request is considered lost
+#define STATUS_WAIT_TIMEOUT 750     // ms, waitForStatus deadline, a lost status request gets re-sent within it
+#define READER_WAIT_FOREVER -1
+#define READER_ERROR_BACKOFF 100 // ms
+#define READ_BATCH_SIZE     16  // max number of pending reports drained per wakeup
+#define IO_QUEUE_SIZE       32  // commands waiting for the I/O thread, must be a power of 2
+#define REPORT_RING_SIZE    256 // raw reports waiting for the parser thread, must be a power of 2
+#define PARSER_WAIT_TIMEOUT 10  // ms, the reader signals the parser without a lock, this bounds a missed wake up
+#define LINK_STALL_TIMEOUT  750  // ms, default time without a status reply before the link is considered dead
+#define RECONNECT_RETRY_DELAY 50  // ms, delay between attempts to reopen the device
+#define RECONNECT_TIMEOUT   1000 // ms, how long commands wait for an ongoing reconnect before failing
+#define ENUM_CACHE_TTL      2000 // ms, lifetime of the device list when there is no hotplug monitor to keep it current
+#define STATE_VERSION_LEN   64  // firmware version string and serial number, the names are bounded by FRAME_NAME_LEN
+#define FRAME_CODES         256 // one dispatch slot per frame code
+
+static_assert(REPORT_SIZE == FRAME_MAX_LEN + 1, "CFrameWriter writes a report ID followed by a full frame");
 
 #define VAL_NOT_AVAILABLE   0xDEADBEEF
 
@@ -57,6 +123,7 @@
 #define K                   273.15f
 #define T25                 (K + 25)
 #define AD_MAX              4095
+#define NTC_BLOCK_SIZE      256     // entries per block of the NTC lookup table, see GetNTCTemperature
 
 
 #define MASK_MAX_STEP           0x00000001
@@ -77,14 +144,32 @@ enum MotorStatus    {IDLE = 0, MOVING};
 enum TempSources    {INTERNAL, EXTERNAL};
 typedef uint8_t byte;
 typedef uint16_t word;
+
+// a report waiting in the I/O queue, report ID in the first byte
+typedef struct _IOCommand {
+    byte        cBuffer[REPORT_SIZE];
+} IOCommand;
+
+// a raw report read by the I/O thread, waiting in the ring for the parser thread
+typedef struct _RawReport {
+    byte        cBuffer[REPORT_SIZE];
+    int         nLength;
+} RawReport;
+
+// returned by sendCommandAsync, completed when parseResponse sees a reply with the same code
+typedef struct _CommandToken {
+    byte        nCode;
+    uint32_t    nSeq;
+} CommandToken;
+
 typedef struct Oasis_setting_atom {
     std::atomic<uint32_t>   nCurPos;
     std::atomic<uint32_t>   nMaxPos;
     std::atomic<bool>   bIsMoving;
     std::atomic<bool>   bIsReversed;
-    std::string         sVersion;
-    std::string         sModel;
-    std::string         sSerial;
+    CInlineString<STATE_VERSION_LEN>    sVersion;
+    CInlineString<FRAME_NAME_LEN>       sModel;
+    CInlineString<STATE_VERSION_LEN>    sSerial;
     std::atomic<word>   nBackstep;
     std::atomic<word>   nBacklash;
     std::atomic<float>  fInternal;
@@ -97,10 +182,91 @@ typedef struct Oasis_setting_atom {
     std::atomic<uint8_t> beepOnMove;
     std::atomic<uint8_t> beepOnStartup;
     std::atomic<uint8_t> bluetoothOn;
-    std::string          sBluetoothName;
-    std::string          sFriendlyName;
+    CInlineString<FRAME_NAME_LEN>       sBluetoothName;
+    CInlineString<FRAME_NAME_LEN>       sFriendlyName;
 } Oasis_Settings_Atom;
 
+// consistent copy of the whole focuser state, published by the parser thread through a seqlock, see getState
+typedef struct Oasis_state {
+    uint32_t    nCurPos;
+    uint32_t    nMaxPos;
+    bool        bIsMoving;
+    bool        bIsReversed;
+    float       fInternal;
+    float       fAmbient;
+    bool        bExternalSensorPresent;
+    uint32_t    backlash;
+    uint8_t     backlashDirection;
+    uint8_t     speed;
+    uint8_t     beepOnMove;
+    uint8_t     beepOnStartup;
+    uint8_t     bluetoothOn;
+    CInlineString<STATE_VERSION_LEN>    sVersion;
+    CInlineString<FRAME_NAME_LEN>       sModel;
+    CInlineString<STATE_VERSION_LEN>    sSerial;
+    CInlineString<FRAME_NAME_LEN>       sBluetoothName;
+    CInlineString<FRAME_NAME_LEN>       sFriendlyName;
+} Oasis_State;
+
+// identity and config values persisted per serial number for warm reconnects
+typedef struct Oasis_device_cache {
+    std::string         sVersion;
+    std::string         sModel;
+    std::string         sBluetoothName;
+    std::string         sFriendlyName;
+    uint32_t            nMaxPos;
+    uint32_t            backlash;
+    uint8_t             backlashDirection;
+    bool                bIsReversed;
+    uint8_t             speed;
+    uint8_t             beepOnMove;
+    uint8_t             beepOnStartup;
+    uint8_t             bluetoothOn;
+} Oasis_Device_Cache;
+
+// collects config changes so they go out as a single CODE_SET_CONFIG, see COasisController::commitConfig.
+// Fields equal to what the focuser already has are dropped from the mask at commit time.
+class COasisConfigTransaction
+{
+public:
+    COasisConfigTransaction() : nMask(0), nMaxStep(0), nBacklash(0), nBacklashDirection(0), bReverse(false),
+                                nSpeed(0), bBeepOnMove(false), bBeepOnStartup(false), bBluetoothOn(false),
+                                bSetBluetoothName(false), bSetFriendlyName(false),
+                                nSentMask(0), nFailedMask(0), nBluetoothNameErr(PLUGIN_OK), nFriendlyNameErr(PLUGIN_OK) {}
+
+    void    setMaxStep(uint32_t nValue)         { nMaxStep = nValue; nMask |= MASK_MAX_STEP; }
+    void    setBacklash(uint32_t nValue)        { nBacklash = nValue; nMask |= MASK_BACKLASH; }
+    void    setBacklashDirection(uint8_t nValue){ nBacklashDirection = nValue; nMask |= MASK_BACKLASH_DIRECTION; }
+    void    setReverse(bool bValue)             { bReverse = bValue; nMask |= MASK_REVERSE_DIRECTION; }
+    void    setSpeed(uint8_t nValue)            { nSpeed = nValue; nMask |= MASK_SPEED; }
+    void    setBeepOnMove(bool bValue)          { bBeepOnMove = bValue; nMask |= MASK_BEEP_ON_MOVE; }
+    void    setBeepOnStartup(bool bValue)       { bBeepOnStartup = bValue; nMask |= MASK_BEEP_ON_STARTUP; }
+    void    setBluetoothEnabled(bool bValue)    { bBluetoothOn = bValue; nMask |= MASK_BLUETOOTH; }
+    // the names have their own frames, they're only sent if they changed
+    void    setBluetoothName(const std::string &sName) { sBluetoothName = sName; bSetBluetoothName = true; }
+    void    setFriendlyName(const std::string &sName)  { sFriendlyName = sName; bSetFriendlyName = true; }
+
+    uint32_t    nMask;
+    uint32_t    nMaxStep;
+    uint32_t    nBacklash;
+    uint8_t     nBacklashDirection;
+    bool        bReverse;
+    uint8_t     nSpeed;
+    bool        bBeepOnMove;
+    bool        bBeepOnStartup;
+    bool        bBluetoothOn;
+    bool        bSetBluetoothName;
+    std::string sBluetoothName;
+    bool        bSetFriendlyName;
+    std::string sFriendlyName;
+
+    // filled by commitConfig so the caller can report what happened to each field
+    uint32_t    nSentMask;          // fields that differed from the focuser and were sent
+    uint32_t    nFailedMask;        // fields that were sent but not confirmed by the read back
+    int         nBluetoothNameErr;
+    int         nFriendlyNameErr;
+};
+
 /*
 
 typedef struct Oasis_setting {
@@ -139,8 +305,18 @@ public:
 
     int         listFocusers(std::vector<std::string> &focuserSNList);
     bool        isFocuserPresent(std::string sSerial);
+    static void invalidateFocuserList();
     void        setFocuserSerial(std::string sSerial);
     void        setUserConf(bool bUserConf);
+    void        setTransport(int nTransport);
+    void        setLogLevel(int nLevel);
+    void        setDeviceCache(const Oasis_Device_Cache &cache);
+    void        clearDeviceCache();
+    bool        getDeviceCache(Oasis_Device_Cache &cache);
+    int         getTransport();
+    int         getActiveTransport();
+    void        setSimulatorProbe(bool bPresent);
+    int         setFaultInjection(const std::string &sSpec);
 
     // move commands
     int         haltFocuser();
@@ -151,6 +327,7 @@ public:
     int         isGoToComplete(bool &bComplete);
 
     // getter and setter
+    uint32_t    getState(Oasis_State &state);
     void        getFirmwareVersion(std::string &sFirmware);
     double      getTemperature();
     double      getTemperature(int nSource);
@@ -186,9 +363,55 @@ public:
     int         setBluetoothName(std::string sName);
     void        getFriendlyName(std::string &sName);
     int         setFriendlyName(std::string sName);
+    void        refreshDeviceNames();
+    int         commitConfig(COasisConfigTransaction &config);
 
     void        parseResponse(byte *Buffer, int nLength);
-    int         sendSettings();
+
+    // parseResponse looks the handler up by frame code, codes without one are plain acks that only
+    // release the waiter. Handlers run with m_GlobalMutex held and return false on a malformed frame.
+    // A plain function so code outside the controller can handle a code too, pContext is passed back as registered.
+    // Registration is only allowed while disconnected.
+    typedef bool (*FrameHandler)(void *pContext, const byte *Buffer, int nLength);
+    int         registerFrameHandler(byte nCode, FrameHandler pHandler, void *pContext);
+
+    // raw device access through the transport devOpen picked, see OasisTransport.h
+    // Only the I/O thread calls these while it's running.
+    int         devWrite(const byte *cHIDBuffer, int nLength);
+    int         devRead(byte *cHIDBuffer, int nLength, int nTimeoutMs);
+    void        wakeIO();
+    void        waitIOBackoff(int nTimeoutMs);
+
+    // I/O thread, owns the device. Everyone else goes through the command queue or the halt slot
+    void        flushCommands();
+    int         nextIOTimeout();
+    void        getHaltLatency(int &nLastUs, int &nMaxUs);
+    std::atomic<bool>   m_bStopIO;
+
+    // parser thread, fed by the I/O thread through the report ring
+    bool        queueReport(const byte *cHIDBuffer, int nLength);
+    void        parseReports();
+    void        waitForReports();
+    void        checkRestore();
+    void        getReportRingStats(int &nOccupancy, int &nHighWater, uint32_t &nOverflows);
+    std::atomic<bool>   m_bStopParser;
+
+    // request / response correlation
+    int         sendCommandAsync(byte *cHIDBuffer, CommandToken &token);
+    int         waitForReply(const CommandToken &token, int nTimeoutMs = CMD_REPLY_TIMEOUT);
+
+    // status polling
+    int         nextStatusInterval(int nPrevIntervalMs);
+    void        pollStatus();
+    int         sendStatusRequest();
+    void        requestStatusRefresh();
+
+    // link watchdog and automatic reconnect
+    bool        isLinkStalled();
+    void        signalLinkError();
+    int         reopenDevice();
+    void        setStallTimeout(int nTimeoutMs);
+    int         setFrameTrace(bool bEnabled);
 
     int         getConfig();
     int         getBluetoothName();
@@ -198,17 +421,15 @@ public:
     int         getSerial();
 
     std::atomic<bool>   m_bGotconfig;
+    std::atomic<bool>   m_bGotStatus;
+    std::atomic<bool>   m_bLiveVersion;
+    std::atomic<bool>   m_bLiveConfig;
     std::atomic<bool>   m_bGotBluetoothName;
     std::atomic<bool>   m_bGotFriendlyName;
     std::atomic<bool>   m_bGotModel;
     std::atomic<bool>   m_bGotVersion;
 
     std::mutex          m_GlobalMutex;
-    std::mutex          m_DevAccessMutex;
-
-#ifdef PLUGIN_DEBUG
-    void  logToFile(const std::string sLogLine);
-#endif
 
     std::atomic<bool>   m_bNeedReconnect;
     int    m_nPosBeforeReconnect;
@@ -220,51 +441,147 @@ protected:
 
     void            startThreads();
     void            stopThreads();
-    int             sendCommand(byte *cHIDBuffer);
+    void            requestHalt(CommandToken &token);
+    void            flushHalt();
+    int             queueGoto(long nPos, CommandToken &token);
+    bool            gotoStarted(long nPos, long nStartPos);
+    int             waitForStatus(int nTimeoutMs = STATUS_WAIT_TIMEOUT);
+    int             queueSyncPosition(unsigned int nPos, CommandToken &token);
+    int             sendCommand(byte *cHIDBuffer, int nTimeoutMs = CMD_REPLY_TIMEOUT);
+    int             sendQuery(byte nCode, CommandToken &token);
+    int             queryDeviceInfo(const byte *cQueries, int nQueries, int nTimeoutMs);
+    void            requestDeviceMetadata();
+    void            ensureDeviceInfo(byte nCode);
+    std::atomic<bool> *gotFlag(byte nCode);
+    void            applyDeviceCache();
+    void            publishState();
+    void            completeReply(byte nCode);
+
+    // frame handlers, see defaultFrameHandlers
+    bool            onProductModel(const byte *Buffer, int nLength);
+    bool            onVersion(const byte *Buffer, int nLength);
+    bool            onFriendlyName(const byte *Buffer, int nLength);
+    bool            onBluetoothName(const byte *Buffer, int nLength);
+    bool            onConfig(const byte *Buffer, int nLength);
+    bool            onStatus(const byte *Buffer, int nLength);
+    // the built in handlers are members, this turns one into a FrameHandler with the controller as context
+    template <bool (COasisController::*HANDLER)(const byte *, int)>
+    static bool memberFrameHandler(void *pContext, const byte *Buffer, int nLength)
+    {
+        return (static_cast<COasisController *>(pContext)->*HANDLER)(Buffer, nLength);
+    }
+    static constexpr std::array<FrameHandler, FRAME_CODES> defaultFrameHandlers();
+    static const std::array<FrameHandler, FRAME_CODES> DefaultFrameHandlers;
+    int             waitForLink(int nTimeoutMs);
+    void            restoreAfterReconnect();
+
+    int             devOpen();
+    void            devClose();
+    void            attachHidRuntime();
+    void            detachHidRuntime();
+    void            openFrameTrace();
+    bool            isDeviceOpen();
+    std::atomic<bool>   m_bDeviceOpen;
+    int             openTransport(COasisTransport &transport);
     
     int         GetNTCTemperature(int ad);
 
     std::string         m_sSerialNumber;
     bool                m_bSetUserConf;
-    hid_device          *m_DevHandle;
+    int                 m_nTransport;
+    int                 m_nActiveTransport;
     bool                m_bDebugLog;
     std::atomic<bool>   m_bIsConnected;
 
-    long                m_nTargetPos;
+    std::atomic<long>   m_nTargetPos;       // set by the goto callers, read by restoreAfterReconnect on the parser thread
     bool                m_bPosLimitEnabled;
     int                 m_nGotoTries;
 
     int                 m_nTempSource;
 
-    // the read thread keep updating these
+    // the read thread keep updating these, under m_GlobalMutex. Readers go through m_State
     Oasis_Settings_Atom m_Oasis_Settings;
+    CSeqLock<Oasis_State> m_State;
+    Oasis_Device_Cache  m_DeviceCache;
+    std::atomic<bool>   m_bHaveDeviceCache;
     // Oasis_Settings      m_Oasis_Settings_Write;
 
+    typedef struct _FrameHandlerEntry {
+        FrameHandler    pHandler;
+        void            *pContext;
+    } FrameHandlerEntry;
+    std::array<FrameHandlerEntry, FRAME_CODES> m_FrameHandlers;
+
     // threads
     bool                m_ThreadsAreRunning;
-    std::promise<void> *m_exitSignal;
-    std::future<void>   m_futureObj;
-    std::promise<void> *m_exitSignalSender;
-    std::future<void>   m_futureObjSender;
+    std::mutex              m_IOMutex;
+    std::condition_variable m_IOCond;
     std::thread         m_th;
-    std::thread         m_thSender;
+    CMpscQueue<IOCommand, IO_QUEUE_SIZE> m_CommandQueue;
+    IOCommand           m_RetryCmd;     // write that failed, sent again after the device is reopened
+    bool                m_bHaveRetryCmd;
+
+    // raw reports, pushed by the I/O thread and parsed on m_thParser so a slow parse never delays a read
+    std::thread         m_thParser;
+    CSpscRing<RawReport, REPORT_RING_SIZE> m_ReportRing;
+    std::mutex              m_ParserMutex;
+    std::condition_variable m_ParserCond;
+    std::atomic<bool>   m_bParserIdle;
+    std::atomic<int>    m_nRingHighWater;
+    std::atomic<uint32_t> m_nRingOverflows; // reports dropped because the ring was full
+    uint32_t            m_nRingOverflowsLogged;
+
+    // halt slot, checked by the I/O thread before anything in the queue
+    std::atomic<bool>   m_bHaltRequested;
+    std::atomic<int64_t> m_nHaltRequestTime; // steady_clock, us
+    std::atomic<int>    m_nHaltLatency;     // us, last request to write time
+    std::atomic<int>    m_nHaltLatencyMax;  // us
+
+    // status polling, only touched by the I/O thread except for the flags
+    std::atomic<bool>   m_bStatusRefresh;
+    std::atomic<bool>   m_bStatusPending;
+    CStopWatch          m_statusTimer;
+    int                 m_nStatusInterval;
+    std::chrono::steady_clock::time_point m_nextStatusTime;
+    std::atomic<bool>   m_bGotoPending;
+
+    // link watchdog
+    std::atomic<bool>   m_bLinkError;
+    CStopWatch          m_stallTimer;
+    int                 m_nStallTimeout;
+    std::atomic<bool>   m_bRestorePending;
 
     CStopWatch          m_gotoTimer;
 
+    // reply counters per frame code, bumped by parseResponse
+    std::mutex              m_ReplyMutex;
+    std::condition_variable m_ReplyCond;
+    uint32_t                m_nReplySeq[256];
+
     std::string&    trim(std::string &str, const std::string &filter );
     std::string&    ltrim(std::string &str, const std::string &filter);
     std::string&    rtrim(std::string &str, const std::string &filter);
 
-    
-#ifdef PLUGIN_DEBUG
-    void    hexdump(const byte *inputData, int inputSize,  std::string &outHex);
-    // timestamp for logs
-    const std::string getTimeStamp();
-    std::string m_hexOut;
-    std::ofstream m_sLogFile;
+
+    void    logBanner();
+    COasisLogger m_Logger;
+    CFrameTrace m_FrameTrace;
+
+    // after m_Logger, they log through it. m_pTransport is the one devOpen picked, read by wakeIO from any thread
+    CHidapiTransport    m_HidapiTransport;
+#ifdef SB_LINUX_BUILD
+    CHidrawTransport    m_HidrawTransport;
+#endif
+    COasisSimulator     m_Simulator;
+    COasisFaultTransport m_FaultTransport;  // wraps the transport devOpen picked when m_bFaultInjection is set
+    bool                m_bFaultInjection;
+    bool                m_bHotplugUser;     // holds a reference on the udev monitor, from Connect to Disconnect
+    std::atomic<bool>   m_bHidUser;         // holds a reference on the hid runtime, from the first enumeration or Connect to Disconnect
+    std::atomic<COasisTransport *> m_pTransport;
     std::string m_sPlatform;
     std::string m_sLogfilePath;
-#endif
+    std::string m_sTraceFolder;
+    bool        m_bFrameTrace;
 
 
 };
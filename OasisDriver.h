@@ -0,0 +1,67 @@
+//
+//  OasisDriver.h
+//  Oasis X2 plugin
+//
+//  TheSkyX's side of the controller for the programs that drive it without TheSkyX, OasisSimTest and
+//  OasisFaultBench. Gotos are polled the way TheSkyX polls them, states are waited for on the published snapshot.
+
+#ifndef __OasisDriver__
+#define __OasisDriver__
+
+#include <chrono>
+#include <thread>
+
+#include "Oasis.h"
+
+#define DRIVER_MOVE_TIMEOUT     15000   // ms, a goto that takes longer fails
+#define DRIVER_STATE_TIMEOUT    5000    // ms, a status poll at the idle back off plus margin
+#define DRIVER_POLL             10      // ms, isGoToComplete and state polling interval
+
+static inline double elapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// polls the state until bDone returns true, false on timeout
+template <typename F>
+static inline bool waitForState(COasisController &controller, int nTimeoutMs, F bDone)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    Oasis_State state;
+
+    while(true) {
+        controller.getState(state);
+        if(bDone(state))
+            return true;
+        if(elapsedMs(start) > nTimeoutMs)
+            return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(DRIVER_POLL));
+    }
+}
+
+static inline bool waitForStop(COasisController &controller, int nTimeoutMs = DRIVER_STATE_TIMEOUT)
+{
+    return waitForState(controller, nTimeoutMs, [](const Oasis_State &state) { return !state.bIsMoving; });
+}
+
+// gotoPosition then isGoToComplete until done, fMs is the whole move
+static inline int runGoto(COasisController &controller, long nTarget, double &fMs)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    bool bComplete = false;
+    int nErr;
+
+    nErr = controller.gotoPosition(nTarget);
+    while(!nErr && !bComplete) {
+        if(elapsedMs(start) > DRIVER_MOVE_TIMEOUT)
+            nErr = ERR_CMDFAILED;
+        else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(DRIVER_POLL));
+            nErr = controller.isGoToComplete(bComplete);
+        }
+    }
+    fMs = elapsedMs(start);
+    return nErr;
+}
+
+#endif /* __OasisDriver__ */
@@ -0,0 +1,195 @@
+//
+//  OasisFaultBench.cpp
+//  Oasis X2 plugin
+//
+//  Worst case latencies of connect, goto and halt with link faults injected between the controller and the
+//  in process simulator, built and run with "make faultbench". A fault free run comes first as the baseline,
+//  then one run per fixed seed. A seed gives the same fault sequence, which request it hits still depends on
+//  timing so the numbers move a little from one run to the next.
+//
+//  usage : oasis_faultbench [-p fault_profile] [-s seeds] [-g gotos] [-l log_level]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+#include "Oasis.h"
+#include "OasisDriver.h"
+
+#define FAULTBENCH_PROFILE      "drop=0.05,error=0.02,lose=0.05,dup=0.02,delay=0.1,reorder=0.02,short=0.02,min=5,max=100,dist=exp"
+#define FAULTBENCH_SEEDS        5       // seeds 1 to n
+#define FAULTBENCH_GOTOS        10      // per seed
+#define FAULTBENCH_SPEED        4       // fastest, so the moves are short and the link overhead shows
+#define FAULTBENCH_MOVE_STEPS   1000    // each goto, alternating direction
+#define FAULTBENCH_CONNECT_TRIES 3
+#define FAULTBENCH_STOP_TIMEOUT 5000    // ms, halt to stopped status
+#define FAULTBENCH_HALT_TARGET  50000   // far enough that the move is still running when it's halted
+#define FAULTBENCH_HALT_AFTER   300     // ms into the move
+
+typedef struct _FaultRun {
+    int         nConnectTries;      // 0 when it never connected
+    double      fConnectMs;         // the successful attempt
+    int         nGotoFailures;
+    double      fGotoMedianMs;
+    double      fGotoMaxMs;
+    int         nHaltErr;           // what haltFocuser returned
+    bool        bHaltStopped;
+    double      fHaltStopMs;        // halt call to stopped status
+    int         nHaltWriteMaxUs;    // halt request to write, from getHaltLatency
+} FaultRun;
+
+static void runProfile(const std::string &sProfile, int nGotos, int nLogLevel, FaultRun &run)
+{
+    COasisController controller;
+    COasisConfigTransaction config;
+    std::vector<double> gotoMs;
+    std::chrono::steady_clock::time_point start;
+    double fMs = 0;
+    long nTarget;
+    int nLastUs;
+    int nGoto;
+    int nErr;
+
+    run = FaultRun();
+    controller.setLogLevel(nLogLevel);
+    controller.setTransport(TRANSPORT_SIMULATOR);
+    if(controller.setFaultInjection(sProfile) != PLUGIN_OK) {
+        fprintf(stderr, "bad fault profile '%s'\n", sProfile.c_str());
+        exit(1);
+    }
+
+    for(int nTry = 1; nTry <= FAULTBENCH_CONNECT_TRIES; nTry++) {
+        start = std::chrono::steady_clock::now();
+        nErr = controller.Connect();
+        run.fConnectMs = elapsedMs(start);
+        if(nErr == PLUGIN_OK) {
+            run.nConnectTries = nTry;
+            break;
+        }
+    }
+    if(!run.nConnectTries)
+        return;
+
+    // the read back can get lost too, every run has to move at the same speed
+    config.setSpeed(FAULTBENCH_SPEED);
+    for(int nTry = 0; nTry < FAULTBENCH_CONNECT_TRIES && controller.getSpeed() != FAULTBENCH_SPEED; nTry++)
+        controller.commitConfig(config);
+
+    for(nGoto = 0; nGoto < nGotos; nGoto++) {
+        nTarget = controller.getPosition() + ((nGoto & 1) ? -FAULTBENCH_MOVE_STEPS : FAULTBENCH_MOVE_STEPS);
+        nErr = runGoto(controller, nTarget, fMs);
+        if(nErr) {
+            // a lost ack still leaves the focuser moving, let it finish before the next goto
+            run.nGotoFailures++;
+            waitForStop(controller, FAULTBENCH_STOP_TIMEOUT);
+        }
+        else
+            gotoMs.push_back(fMs);
+    }
+    if(gotoMs.size()) {
+        std::sort(gotoMs.begin(), gotoMs.end());
+        run.fGotoMedianMs = gotoMs[gotoMs.size() / 2];
+        run.fGotoMaxMs = gotoMs.back();
+    }
+
+    // halted whatever the goto returns, its ack may be the only thing that got lost
+    controller.gotoPosition(FAULTBENCH_HALT_TARGET);
+    std::this_thread::sleep_for(std::chrono::milliseconds(FAULTBENCH_HALT_AFTER));
+    start = std::chrono::steady_clock::now();
+    run.nHaltErr = controller.haltFocuser();
+    run.bHaltStopped = waitForStop(controller, FAULTBENCH_STOP_TIMEOUT);
+    run.fHaltStopMs = elapsedMs(start);
+    controller.getHaltLatency(nLastUs, run.nHaltWriteMaxUs);
+
+    controller.Disconnect();
+}
+
+static void printRun(const char *szName, const FaultRun &run, int nGotos)
+{
+    if(!run.nConnectTries) {
+        printf("%-8s never connected in %d tries\n", szName, FAULTBENCH_CONNECT_TRIES);
+        return;
+    }
+    printf("%-8s %6.0f %5d %7.0f %7.0f %5d/%-3d ", szName, run.fConnectMs, run.nConnectTries,
+           run.fGotoMedianMs, run.fGotoMaxMs, run.nGotoFailures, nGotos);
+    if(run.bHaltStopped)
+        printf("%7.0f %8d\n", run.fHaltStopMs, run.nHaltWriteMaxUs);
+    else
+        printf("%7s %8d  still moving %d ms after the halt, haltFocuser returned %d\n", "stuck", run.nHaltWriteMaxUs,
+               FAULTBENCH_STOP_TIMEOUT, run.nHaltErr);
+}
+
+int main(int argc, char *argv[])
+{
+    std::string sProfile = FAULTBENCH_PROFILE;
+    FaultRun run;
+    FaultRun worst = FaultRun();
+    char szSeed[16];
+    int nSeeds = FAULTBENCH_SEEDS;
+    int nGotos = FAULTBENCH_GOTOS;
+    int nLogLevel = LOG_LEVEL_OFF;
+    int nNeverConnected = 0;
+    int nSeed;
+    int nOpt;
+
+    while((nOpt = getopt(argc, argv, "p:s:g:l:")) != -1) {
+        switch(nOpt) {
+            case 'p':
+                sProfile = optarg;
+                break;
+            case 's':
+                nSeeds = std::max(1, atoi(optarg));
+                break;
+            case 'g':
+                nGotos = std::max(1, atoi(optarg));
+                break;
+            case 'l':
+                nLogLevel = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-p fault_profile] [-s seeds] [-g gotos] [-l log_level]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    printf("profile %s\n", sProfile.c_str());
+    printf("%d gotos of %d steps at speed %d per run, times in ms, halt write in us\n", nGotos, FAULTBENCH_MOVE_STEPS, FAULTBENCH_SPEED);
+    printf("run      connect tries    goto   worst  failed    halt    write\n");
+
+    runProfile("", nGotos, nLogLevel, run);
+    printRun("no fault", run, nGotos);
+
+    worst.nConnectTries = 1;
+    worst.bHaltStopped = true;
+    for(nSeed = 1; nSeed <= nSeeds; nSeed++) {
+        runProfile(sProfile + ",seed=" + std::to_string(nSeed), nGotos, nLogLevel, run);
+        snprintf(szSeed, sizeof(szSeed), "seed %d", nSeed);
+        printRun(szSeed, run, nGotos);
+
+        if(!run.nConnectTries) {
+            nNeverConnected++;
+            continue;
+        }
+        worst.nConnectTries = std::max(worst.nConnectTries, run.nConnectTries);
+        worst.fConnectMs = std::max(worst.fConnectMs, run.fConnectMs);
+        worst.fGotoMedianMs = std::max(worst.fGotoMedianMs, run.fGotoMedianMs);
+        worst.fGotoMaxMs = std::max(worst.fGotoMaxMs, run.fGotoMaxMs);
+        worst.nGotoFailures += run.nGotoFailures;
+        if(!run.bHaltStopped) {
+            worst.bHaltStopped = false;
+            worst.nHaltErr = run.nHaltErr;
+        }
+        worst.fHaltStopMs = std::max(worst.fHaltStopMs, run.fHaltStopMs);
+        worst.nHaltWriteMaxUs = std::max(worst.nHaltWriteMaxUs, run.nHaltWriteMaxUs);
+    }
+    printRun("worst", worst, nGotos * nSeeds);
+    if(nNeverConnected)
+        printf("%d seed%s never connected\n", nNeverConnected, nNeverConnected == 1 ? "" : "s");
+
+    return 0;
+}
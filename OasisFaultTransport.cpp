@@ -0,0 +1,320 @@
+//
+//  OasisFaultTransport.cpp
+//  Oasis X2 plugin
+//
+//  Fault injecting transport, see OasisFaultTransport.h
+
+#include <cstring>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+
+#include "OasisFaultTransport.h"
+
+static const char *FaultNames[FAULT_TYPES] = {"dropped writes", "write errors", "lost replies", "duplicated replies",
+                                              "delayed reports", "reordered reports", "short reads"};
+
+COasisFaultTransport::COasisFaultTransport(COasisLogger &logger) : m_Logger(logger)
+{
+    int i;
+
+    m_pTransport = nullptr;
+    memset(&m_Profile, 0, sizeof(m_Profile));
+    for(i = 0; i < FAULT_TYPES; i++)
+        m_nFaults[i] = 0;
+}
+
+void COasisFaultTransport::setTransport(COasisTransport *pTransport)
+{
+    m_pTransport = pTransport;
+}
+
+void COasisFaultTransport::setProfile(const FaultProfile &profile)
+{
+    int i;
+
+    m_Profile = profile;
+    m_Random.seed(profile.nSeed ? profile.nSeed : std::random_device()());
+    for(i = 0; i < FAULT_TYPES; i++)
+        m_nFaults[i] = 0;
+}
+
+bool COasisFaultTransport::parseProfile(const std::string &sSpec, FaultProfile &profile)
+{
+    std::stringstream ssSpec(sSpec);
+    std::string sItem;
+    std::string sKey;
+    std::string sValue;
+    size_t nPos;
+    char *pEnd;
+    double fValue;
+
+    memset(&profile, 0, sizeof(profile));
+    profile.nDelayDistribution = FAULT_DELAY_UNIFORM;
+
+    while(std::getline(ssSpec, sItem, ',')) {
+        if(sItem.empty())
+            continue;
+        nPos = sItem.find('=');
+        if(nPos == std::string::npos)
+            return false;
+        sKey = sItem.substr(0, nPos);
+        sValue = sItem.substr(nPos + 1);
+
+        if(sKey == "dist") {
+            if(sValue == "uniform")
+                profile.nDelayDistribution = FAULT_DELAY_UNIFORM;
+            else if(sValue == "exp")
+                profile.nDelayDistribution = FAULT_DELAY_EXPONENTIAL;
+            else
+                return false;
+            continue;
+        }
+
+        fValue = strtod(sValue.c_str(), &pEnd);
+        if(sValue.empty() || *pEnd || fValue < 0)
+            return false;
+        if(sKey == "drop")          profile.fDropWrite = fValue;
+        else if(sKey == "error")    profile.fWriteError = fValue;
+        else if(sKey == "lose")     profile.fLoseReply = fValue;
+        else if(sKey == "dup")      profile.fDuplicateReply = fValue;
+        else if(sKey == "delay")    profile.fDelayReport = fValue;
+        else if(sKey == "reorder")  profile.fReorderReport = fValue;
+        else if(sKey == "short")    profile.fShortRead = fValue;
+        else if(sKey == "min")      profile.fDelayMinMs = fValue;
+        else if(sKey == "max")      profile.fDelayMaxMs = fValue;
+        else if(sKey == "seed")     profile.nSeed = (uint32_t)fValue;
+        else
+            return false;
+    }
+    if(profile.fDelayMaxMs < profile.fDelayMinMs)
+        profile.fDelayMaxMs = profile.fDelayMinMs;
+    return true;
+}
+
+bool COasisFaultTransport::open(std::string &sSerial)
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    m_Pending.clear();
+    if(!pTransport)
+        return false;
+    return pTransport->open(sSerial);
+}
+
+void COasisFaultTransport::close()
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    // whatever was held back is lost with the link
+    m_Pending.clear();
+    if(pTransport)
+        pTransport->close();
+}
+
+bool COasisFaultTransport::isOpen() const
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    return pTransport && pTransport->isOpen();
+}
+
+int COasisFaultTransport::type() const
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    return pTransport ? pTransport->type() : TRANSPORT_HIDAPI;
+}
+
+void COasisFaultTransport::wake()
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    if(pTransport)
+        pTransport->wake();
+}
+
+int COasisFaultTransport::write(const unsigned char *cReport, int nLength)
+{
+    COasisTransport *pTransport = m_pTransport;
+
+    if(!pTransport)
+        return -1;
+
+    if(roll(m_Profile.fWriteError)) {
+        countFault(FAULT_WRITE_ERROR);
+        return -1;
+    }
+    if(roll(m_Profile.fDropWrite)) {
+        countFault(FAULT_DROP_WRITE);
+        return nLength;
+    }
+    return pTransport->write(cReport, nLength);
+}
+
+int COasisFaultTransport::read(unsigned char *cReport, int nLength, int nTimeoutMs)
+{
+    COasisTransport *pTransport = m_pTransport;
+    std::chrono::steady_clock::time_point now;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point nextRelease;
+    FaultReport report;
+    FaultReport copy;
+    int nTimeout;
+    int nRead;
+    bool bFirst = true;
+
+    if(!pTransport)
+        return -1;
+
+    now = std::chrono::steady_clock::now();
+    deadline = now + std::chrono::milliseconds(nTimeoutMs < 0 ? 0 : nTimeoutMs);
+
+    while(true) {
+        now = std::chrono::steady_clock::now();
+        if(!popReady(now, report)) {
+            if(!bFirst && nTimeoutMs >= 0 && now >= deadline)
+                return 0;
+            bFirst = false;
+
+            // don't sleep past the next held back report
+            nTimeout = nTimeoutMs < 0 ? -1 : (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+            if(m_Pending.size()) {
+                nextRelease = m_Pending.front().releaseTime;
+                for(const FaultReport &pending : m_Pending)
+                    nextRelease = std::min(nextRelease, pending.releaseTime);
+                nRead = (int)std::chrono::duration_cast<std::chrono::milliseconds>(nextRelease - now).count() + 1;
+                if(nTimeout < 0 || nRead < nTimeout)
+                    nTimeout = nRead;
+            }
+            if(nTimeout < 0 && nTimeoutMs >= 0)
+                nTimeout = 0;
+
+            nRead = pTransport->read(report.cFrame, FRAME_MAX_LEN, nTimeout);
+            if(nRead < 0)
+                return -1;
+            if(nRead == 0) {
+                // timeout or wake up, unless a held back report is due
+                if(popReady(std::chrono::steady_clock::now(), report))
+                    return deliver(report, cReport, nLength);
+                return 0;
+            }
+
+            now = std::chrono::steady_clock::now();
+            report.nLength = nRead;
+            report.bAfterNext = false;
+            report.releaseTime = now;
+
+            if(roll(m_Profile.fLoseReply)) {
+                countFault(FAULT_LOSE_REPLY);
+                continue;
+            }
+            if(roll(m_Profile.fDuplicateReply)) {
+                countFault(FAULT_DUPLICATE_REPLY);
+                copy = report;
+                m_Pending.push_back(copy);
+            }
+            if(roll(m_Profile.fDelayReport)) {
+                countFault(FAULT_DELAY_REPORT);
+                report.releaseTime = now + drawDelay();
+                m_Pending.push_back(report);
+                continue;
+            }
+            if(roll(m_Profile.fReorderReport)) {
+                countFault(FAULT_REORDER_REPORT);
+                report.bAfterNext = true;
+                report.releaseTime = now + std::chrono::milliseconds(FAULT_REORDER_HOLD);
+                m_Pending.push_back(report);
+                continue;
+            }
+        }
+        return deliver(report, cReport, nLength);
+    }
+}
+
+uint64_t COasisFaultTransport::getFaultCount(int nFault) const
+{
+    if(nFault < 0 || nFault >= FAULT_TYPES)
+        return 0;
+    return m_nFaults[nFault].load(std::memory_order_relaxed);
+}
+
+void COasisFaultTransport::logFaultCounts()
+{
+    int i;
+
+    for(i = 0; i < FAULT_TYPES; i++)
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "COasisFaultTransport", "%-18s : %llu", FaultNames[i], (unsigned long long)getFaultCount(i));
+}
+
+#pragma mark fault helpers
+
+int COasisFaultTransport::deliver(FaultReport &report, unsigned char *cReport, int nLength)
+{
+    int nRead;
+
+    // the report it was held back behind is going out, it can follow
+    releaseReordered(std::chrono::steady_clock::now());
+
+    nRead = report.nLength;
+    if(nRead > 1 && roll(m_Profile.fShortRead)) {
+        countFault(FAULT_SHORT_READ);
+        nRead = 1 + (int)(m_Random() % (uint32_t)(nRead - 1));
+    }
+    nRead = std::min(nRead, nLength);
+    memcpy(cReport, report.cFrame, nRead);
+    return nRead;
+}
+
+bool COasisFaultTransport::roll(double fProbability)
+{
+    if(fProbability <= 0)
+        return false;
+    return std::uniform_real_distribution<double>(0.0, 1.0)(m_Random) < fProbability;
+}
+
+std::chrono::steady_clock::duration COasisFaultTransport::drawDelay()
+{
+    double fDelayMs;
+
+    if(m_Profile.nDelayDistribution == FAULT_DELAY_EXPONENTIAL && m_Profile.fDelayMaxMs > m_Profile.fDelayMinMs) {
+        fDelayMs = m_Profile.fDelayMinMs + std::exponential_distribution<double>(2.0 / (m_Profile.fDelayMaxMs - m_Profile.fDelayMinMs))(m_Random);
+        fDelayMs = std::min(fDelayMs, m_Profile.fDelayMaxMs);
+    }
+    else
+        fDelayMs = std::uniform_real_distribution<double>(m_Profile.fDelayMinMs, std::max(m_Profile.fDelayMinMs, m_Profile.fDelayMaxMs))(m_Random);
+
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(fDelayMs));
+}
+
+// earliest report that is due, held back reports keep their order between themselves
+bool COasisFaultTransport::popReady(std::chrono::steady_clock::time_point now, FaultReport &report)
+{
+    std::deque<FaultReport>::iterator it;
+    std::deque<FaultReport>::iterator next = m_Pending.end();
+
+    for(it = m_Pending.begin(); it != m_Pending.end(); ++it) {
+        if(it->releaseTime <= now && (next == m_Pending.end() || it->releaseTime < next->releaseTime))
+            next = it;
+    }
+    if(next == m_Pending.end())
+        return false;
+    report = *next;
+    m_Pending.erase(next);
+    return true;
+}
+
+void COasisFaultTransport::releaseReordered(std::chrono::steady_clock::time_point now)
+{
+    for(FaultReport &pending : m_Pending) {
+        if(pending.bAfterNext) {
+            pending.bAfterNext = false;
+            pending.releaseTime = now;
+        }
+    }
+}
+
+void COasisFaultTransport::countFault(int nFault)
+{
+    m_nFaults[nFault].fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,93 @@
+//
+//  OasisFaultTransport.h
+//  Oasis X2 plugin
+//
+//  Transport decorator that injects link faults, to measure how the retries, the watchdog and the reconnect
+//  behave when the USB link misbehaves. It wraps whichever transport devOpen picked, usually COasisSimulator.
+//  Every fault has its own probability, delayed reports are held back for a random time drawn from the
+//  configured distribution. A fixed seed replays the same sequence of faults.
+
+#ifndef __OasisFaultTransport__
+#define __OasisFaultTransport__
+
+#include <string>
+#include <deque>
+#include <random>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "FrameCodec.h"
+#include "OasisTransport.h"
+
+#define FAULT_REORDER_HOLD  250     // ms, a report held back behind the next one is let go after this anyway
+
+enum FaultDelayDistributions    {FAULT_DELAY_UNIFORM = 0, FAULT_DELAY_EXPONENTIAL};
+enum FaultTypes     {FAULT_DROP_WRITE = 0, FAULT_WRITE_ERROR, FAULT_LOSE_REPLY, FAULT_DUPLICATE_REPLY,
+                     FAULT_DELAY_REPORT, FAULT_REORDER_REPORT, FAULT_SHORT_READ, FAULT_TYPES};
+
+// probabilities are per write or per report, 0 disables the fault
+typedef struct _FaultProfile {
+    double      fDropWrite;         // write reported as done but never reaches the device
+    double      fWriteError;        // write fails with -1, like hid_write on a dead link
+    double      fLoseReply;         // report read from the device and discarded
+    double      fDuplicateReply;    // report delivered twice
+    double      fDelayReport;       // report held back for a random delay
+    double      fReorderReport;     // report delivered after the next one
+    double      fShortRead;         // report truncated to a random length
+    int         nDelayDistribution;
+    double      fDelayMinMs;
+    double      fDelayMaxMs;        // uniform between min and max, exponential is min plus a tail with a mean of (max - min) / 2, capped at max
+    uint32_t    nSeed;              // 0 picks a random seed
+} FaultProfile;
+
+typedef struct _FaultReport {
+    std::chrono::steady_clock::time_point   releaseTime;
+    bool            bAfterNext;     // reordered, released once another report went out
+    int             nLength;
+    unsigned char   cFrame[FRAME_MAX_LEN];
+} FaultReport;
+
+class COasisFaultTransport : public COasisTransport
+{
+public:
+    COasisFaultTransport(COasisLogger &logger);
+
+    // only while closed
+    void        setTransport(COasisTransport *pTransport);
+    void        setProfile(const FaultProfile &profile);
+    // "drop=0.01,error=0.001,lose=0.02,dup=0.01,delay=0.05,reorder=0.01,short=0.01,min=5,max=200,dist=exp,seed=1"
+    // keys that are left out are 0 (off), returns false on an unknown key or a bad value
+    static bool parseProfile(const std::string &sSpec, FaultProfile &profile);
+
+    bool        open(std::string &sSerial) override;
+    void        close() override;
+    bool        isOpen() const override;
+    int         write(const unsigned char *cReport, int nLength) override;
+    int         read(unsigned char *cReport, int nLength, int nTimeoutMs) override;
+    void        wake() override;
+    int         type() const override;
+
+    uint64_t    getFaultCount(int nFault) const;
+    void        logFaultCounts();
+
+protected:
+    int         deliver(FaultReport &report, unsigned char *cReport, int nLength);
+    bool        roll(double fProbability);
+    std::chrono::steady_clock::duration drawDelay();
+    bool        popReady(std::chrono::steady_clock::time_point now, FaultReport &report);
+    void        releaseReordered(std::chrono::steady_clock::time_point now);
+    void        countFault(int nFault);
+
+    COasisLogger        &m_Logger;
+    std::atomic<COasisTransport *> m_pTransport;
+    FaultProfile        m_Profile;
+    std::mt19937        m_Random;
+
+    // I/O thread only
+    std::deque<FaultReport> m_Pending;
+
+    std::atomic<uint64_t> m_nFaults[FAULT_TYPES];
+};
+
+#endif /* __OasisFaultTransport__ */
@@ -0,0 +1,237 @@
+//
+//  OasisFrameTest.cpp
+//  Oasis X2 plugin
+//
+//  Checks that the frame handling path doesn't allocate, built and run with "make check".
+//  Status, config, version and name frames are fed through COasisController::parseResponse with
+//  operator new counting, any heap allocation on that path is a failure. A handler registered from
+//  outside the controller goes through the same dispatch.
+//  -b runs enough frames to time the dispatch, "make bench".
+//
+//  usage : oasis_frametest [-b] [-n passes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <chrono>
+#include <unistd.h>
+
+#include "Oasis.h"
+
+#define FRAMETEST_PASSES    1000    // times every frame goes through parseResponse
+#define FRAMETEST_BENCH     1000000 // same with -b
+#define FRAMETEST_USER_ID   0xCAFE
+
+// only the allocations made by the thread feeding the frames count, the logger thread is none of our business
+static thread_local bool bCounting = false;
+static long nAllocations = 0;
+
+void *operator new(size_t nSize)
+{
+    void *p;
+
+    if(bCounting)
+        nAllocations++;
+    p = malloc(nSize ? nSize : 1);
+    if(!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void *operator new[](size_t nSize)
+{
+    return operator new(nSize);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
+
+typedef struct _TestFrame {
+    const char      *szName;
+    unsigned char   cReport[REPORT_SIZE];
+} TestFrame;
+
+// an outside handler, the controller doesn't know about user id frames
+typedef struct _UserIdContext {
+    long        nFrames;
+    uint32_t    nUserId;
+} UserIdContext;
+
+static bool onUserId(void *pContext, const byte *Buffer, int nLength)
+{
+    UserIdContext *pUserId = static_cast<UserIdContext *>(pContext);
+    CFrameView<FrameUserID> view(Buffer, nLength);
+
+    if(!view.valid())
+        return false;
+    pUserId->nUserId = FrameGet(view, FrameUserID, userID);
+    pUserId->nFrames++;
+    return true;
+}
+
+template <typename T>
+static void writeName(TestFrame &frame, unsigned char nCode, const char *szName)
+{
+    CFrameWriter<T> writer(frame.cReport, nCode);
+    writer.template setBytes<T, offsetof(T, data), sizeof(T::data)>(szName, strlen(szName));
+}
+
+// the replies a connected focuser sends, as the device would, report ID 0 first
+static void buildFrames(std::vector<TestFrame> &frames)
+{
+    TestFrame frame;
+
+    frame.szName = "status";
+    {
+        CFrameWriter<FrameStatusAck> writer(frame.cReport, CODE_GET_STATUS);
+        FrameSet(writer, FrameStatusAck, temperatureInt, 2048);
+        FrameSet(writer, FrameStatusAck, temperatureExt, 200); // 12.5 C in 1/16 C
+        FrameSet(writer, FrameStatusAck, temperatureDetection, 1);
+        FrameSet(writer, FrameStatusAck, moving, 1);
+        FrameSet(writer, FrameStatusAck, position, 12345);
+    }
+    frames.push_back(frame);
+
+    frame.szName = "config";
+    {
+        CFrameWriter<FrameConfig> writer(frame.cReport, CODE_GET_CONFIG);
+        FrameSet(writer, FrameConfig, mask, MASK_ALL);
+        FrameSet(writer, FrameConfig, maxStep, 100000);
+        FrameSet(writer, FrameConfig, backlash, 40);
+        FrameSet(writer, FrameConfig, backlashDirection, 1);
+        FrameSet(writer, FrameConfig, reverseDirection, 0);
+        FrameSet(writer, FrameConfig, speed, 3);
+        FrameSet(writer, FrameConfig, beepOnMove, 1);
+        FrameSet(writer, FrameConfig, beepOnStartup, 0);
+        FrameSet(writer, FrameConfig, bluetoothOn, 1);
+    }
+    frames.push_back(frame);
+
+    frame.szName = "version";
+    {
+        const char szBuilt[] = "Oct 18 2026 12:00:00";
+        CFrameWriter<FrameVersionAck> writer(frame.cReport, CODE_GET_VERSION);
+        FrameSet(writer, FrameVersionAck, protocal, 0x01000000);
+        FrameSet(writer, FrameVersionAck, hardware, 0x01000000);
+        FrameSet(writer, FrameVersionAck, firmware, 0x01020304);
+        FrameSetBytes(writer, FrameVersionAck, built, szBuilt, sizeof(szBuilt) - 1);
+    }
+    frames.push_back(frame);
+
+    frame.szName = "model";
+    writeName<FrameProductModelAck>(frame, CODE_GET_PRODUCT_MODEL, "Oasis Focuser");
+    frames.push_back(frame);
+
+    frame.szName = "bluetooth name";
+    writeName<FrameBluetoothName>(frame, CODE_GET_BLUETOOTH_NAME, "Oasis-0123456789abcdef0123456789");
+    frames.push_back(frame);
+
+    frame.szName = "friendly name";
+    writeName<FrameFriendlyName>(frame, CODE_GET_FRIENDLY_NAME, "Main imaging scope focuser");
+    frames.push_back(frame);
+
+    frame.szName = "user id";
+    {
+        CFrameWriter<FrameUserID> writer(frame.cReport, CODE_GET_USER_ID);
+        FrameSet(writer, FrameUserID, userID, FRAMETEST_USER_ID);
+    }
+    frames.push_back(frame);
+
+    frame.szName = "goto ack";
+    {
+        CFrameWriter<FrameCommandAck> writer(frame.cReport, CODE_CMD_MOVE_TO);
+        FrameSet(writer, FrameCommandAck, result, 0);
+    }
+    frames.push_back(frame);
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<TestFrame> frames;
+    COasisController controller;
+    UserIdContext userId = {0, 0};
+    int nPasses = FRAMETEST_PASSES;
+    int nFailures = 0;
+    int nPass;
+    int nOpt;
+    int nErr;
+    long nFrameAllocations;
+    double dNsPerFrame;
+    Oasis_State state;
+
+    while((nOpt = getopt(argc, argv, "bn:")) != -1) {
+        switch(nOpt) {
+            case 'b':
+                nPasses = FRAMETEST_BENCH;
+                break;
+            case 'n':
+                nPasses = std::max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-b] [-n passes]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // not connected, parseResponse only updates the state and releases nobody
+    controller.setLogLevel(LOG_LEVEL_OFF);
+    buildFrames(frames);
+    nErr = controller.registerFrameHandler(CODE_GET_USER_ID, &onUserId, &userId);
+    printf("%s registerFrameHandler for user id returns %d\n", nErr ? "FAIL" : "ok  ", nErr);
+    if(nErr)
+        nFailures++;
+
+    for(TestFrame &frame : frames) {
+        nAllocations = 0;
+        bCounting = true;
+        auto start = std::chrono::steady_clock::now();
+        for(nPass = 0; nPass < nPasses; nPass++)
+            controller.parseResponse(frame.cReport + 1, FRAME_MAX_LEN);
+        dNsPerFrame = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / nPasses;
+        bCounting = false;
+        nFrameAllocations = nAllocations;
+        printf("%s %-16s %ld allocations in %d frames, %.1f ns per frame\n", nFrameAllocations ? "FAIL" : "ok  ",
+               frame.szName, nFrameAllocations, nPasses, dNsPerFrame);
+        if(nFrameAllocations)
+            nFailures++;
+    }
+
+    if(userId.nFrames != nPasses || userId.nUserId != FRAMETEST_USER_ID) {
+        printf("FAIL user id handler saw %ld frames, id 0x%X\n", userId.nFrames, (unsigned int)userId.nUserId);
+        nFailures++;
+    }
+    else
+        printf("ok   user id handler saw every frame\n");
+
+    // and the frames were actually taken in, not dropped as malformed
+    controller.getState(state);
+    if(state.nCurPos != 12345 || state.nMaxPos != 100000 || state.speed != 3 || !state.bExternalSensorPresent ||
+       strcmp(state.sModel.c_str(), "Oasis Focuser") || strcmp(state.sFriendlyName.c_str(), "Main imaging scope focuser") ||
+       strcmp(state.sBluetoothName.c_str(), "Oasis-0123456789abcdef0123456789") || !state.sVersion.size()) {
+        printf("FAIL state doesn't match the frames\n");
+        nFailures++;
+    }
+    else
+        printf("ok   state matches the frames, firmware %s\n", state.sVersion.c_str());
+
+    printf("%d failure%s\n", nFailures, nFailures == 1 ? "" : "s");
+    return nFailures ? 1 : 0;
+}
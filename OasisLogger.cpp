@@ -0,0 +1,203 @@
+//
+//  OasisLogger.cpp
+//  Oasis X2 plugin
+//
+//  Asynchronous file logger, see OasisLogger.h
+
+#include <cstdarg>
+#include <cstring>
+#include <ctime>
+#include <chrono>
+
+#include "OasisLogger.h"
+
+void threaded_logwriter(COasisLogger *OasisLoggerObj)
+{
+    if(!OasisLoggerObj)
+        return;
+
+    while (!OasisLoggerObj->m_bStopWriter) {
+        OasisLoggerObj->writeRecords();
+        OasisLoggerObj->waitForRecords();
+    }
+    // whatever was logged before the stop request still goes out
+    OasisLoggerObj->writeRecords();
+}
+
+COasisLogger::COasisLogger()
+{
+    m_nLevel = LOG_LEVEL_OFF;
+    m_pLogFile = nullptr;
+    m_nDropped = 0;
+    m_nDroppedReported = 0;
+    m_bStopWriter = false;
+}
+
+COasisLogger::~COasisLogger()
+{
+    const std::lock_guard<std::mutex> lock(m_ControlMutex);
+
+    m_nLevel = LOG_LEVEL_OFF;
+    stopWriter();
+    if(m_pLogFile) {
+        fclose(m_pLogFile);
+        m_pLogFile = nullptr;
+    }
+}
+
+void COasisLogger::setLogFile(const std::string &sPath)
+{
+    const std::lock_guard<std::mutex> lock(m_ControlMutex);
+
+    // can't move an open log
+    if(!m_pLogFile)
+        m_sLogFilePath = sPath;
+}
+
+void COasisLogger::setLevel(int nLevel)
+{
+    const std::lock_guard<std::mutex> lock(m_ControlMutex);
+
+    if(nLevel < LOG_LEVEL_OFF)
+        nLevel = LOG_LEVEL_OFF;
+    if(nLevel > LOG_LEVEL_DEBUG)
+        nLevel = LOG_LEVEL_DEBUG;
+
+    if(nLevel != LOG_LEVEL_OFF && !m_pLogFile) {
+        if(m_sLogFilePath.empty())
+            return;
+        m_pLogFile = fopen(m_sLogFilePath.c_str(), "w");
+        if(!m_pLogFile)
+            return;
+        startWriter();
+    }
+    m_nLevel = nLevel;
+}
+
+void COasisLogger::log(int nLevel, const char *szFunc, const char *szFormat, ...)
+{
+    LogRecord record;
+    va_list args;
+
+    if(!enabled(nLevel))
+        return;
+
+    record.nTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.szFunc = szFunc;
+    record.nLevel = nLevel;
+    record.nHexLen = 0;
+    va_start(args, szFormat);
+    vsnprintf(record.szText, LOG_TEXT_LEN, szFormat, args);
+    va_end(args);
+    push(record);
+}
+
+void COasisLogger::logHex(int nLevel, const char *szFunc, const unsigned char *pData, int nLength, const char *szFormat, ...)
+{
+    LogRecord record;
+    va_list args;
+
+    if(!enabled(nLevel))
+        return;
+
+    if(nLength < 0)
+        nLength = 0;
+    if(nLength > LOG_HEX_LEN)
+        nLength = LOG_HEX_LEN;
+
+    record.nTimeUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    record.szFunc = szFunc;
+    record.nLevel = nLevel;
+    record.nHexLen = nLength;
+    va_start(args, szFormat);
+    vsnprintf(record.szText, LOG_TEXT_LEN, szFormat, args);
+    va_end(args);
+    memcpy(record.cHex, pData, nLength);
+    push(record);
+}
+
+void COasisLogger::push(const LogRecord &record)
+{
+    if(!m_Records.push(record))
+        m_nDropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+#pragma mark writer thread
+
+void COasisLogger::startWriter()
+{
+    if(m_thWriter.joinable())
+        return;
+    m_bStopWriter = false;
+    m_thWriter = std::thread(&threaded_logwriter, this);
+}
+
+void COasisLogger::stopWriter()
+{
+    if(!m_thWriter.joinable())
+        return;
+    {
+        const std::lock_guard<std::mutex> lock(m_WriterMutex);
+        m_bStopWriter = true;
+    }
+    m_WriterCond.notify_one();
+    m_thWriter.join();
+}
+
+void COasisLogger::waitForRecords()
+{
+    std::unique_lock<std::mutex> lock(m_WriterMutex);
+
+    if(m_bStopWriter)
+        return;
+    m_WriterCond.wait_for(lock, std::chrono::milliseconds(LOG_WRITE_INTERVAL));
+}
+
+void COasisLogger::writeRecords()
+{
+    LogRecord record;
+    uint64_t nDropped;
+    bool bWrote = false;
+
+    if(!m_pLogFile)
+        return;
+
+    while(m_Records.pop(record)) {
+        writeRecord(record);
+        bWrote = true;
+    }
+
+    nDropped = m_nDropped.load(std::memory_order_relaxed);
+    if(nDropped != m_nDroppedReported) {
+        fprintf(m_pLogFile, "[log] queue full, %llu record(s) dropped, %llu total\n",
+                (unsigned long long)(nDropped - m_nDroppedReported), (unsigned long long)nDropped);
+        m_nDroppedReported = nDropped;
+        bWrote = true;
+    }
+
+    if(bWrote)
+        fflush(m_pLogFile);
+}
+
+void COasisLogger::writeRecord(const LogRecord &record)
+{
+    time_t  now = (time_t)(record.nTimeUs / 1000000);
+    struct tm tstruct;
+    char    szTime[80];
+    int     i;
+
+    // localtime's static buffer is shared with whatever else in the host process calls it
+#if defined(SB_WIN_BUILD)
+    localtime_s(&tstruct, &now);
+#else
+    localtime_r(&now, &tstruct);
+#endif
+    strftime(szTime, sizeof(szTime), "%Y-%m-%d.%X", &tstruct);
+    fprintf(m_pLogFile, "[%s.%06d] [%s] %s\n", szTime, (int)(record.nTimeUs % 1000000), record.szFunc, record.szText);
+
+    for(i = 0; i < record.nHexLen; i++) {
+        fprintf(m_pLogFile, "0x%02X ", record.cHex[i]);
+        if((i%16) == 15 || i == record.nHexLen - 1)
+            fputc('\n', m_pLogFile);
+    }
+}
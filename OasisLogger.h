@@ -0,0 +1,91 @@
+//
+//  OasisLogger.h
+//  Oasis X2 plugin
+//
+//  Asynchronous file logger with a runtime level.
+//  Callers format their line into a fixed size record and push it on a lock-free queue. A background thread
+//  adds the timestamp, writes the records and flushes the file once per batch, so the calling thread
+//  never allocates, takes a lock or waits on the disk. If the queue is full the record is dropped and counted.
+
+#ifndef __OasisLogger__
+#define __OasisLogger__
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+
+#include "MpscQueue.h"
+
+#define LOG_QUEUE_SIZE      1024    // records waiting for the writer thread, must be a power of 2
+#define LOG_TEXT_LEN        200     // formatted text per record, longer lines are truncated
+#define LOG_HEX_LEN         72      // raw bytes per record for hex dumps, a whole HID report fits
+#define LOG_WRITE_INTERVAL  100     // ms, how often the writer thread drains the queue
+
+enum LogLevels      {LOG_LEVEL_OFF = 0, LOG_LEVEL_ERROR, LOG_LEVEL_INFO, LOG_LEVEL_DEBUG};
+
+#ifdef __GNUC__
+#define LOG_PRINTF_FORMAT(fmt, args)    __attribute__((format(printf, fmt, args)))
+#else
+#define LOG_PRINTF_FORMAT(fmt, args)
+#endif
+
+typedef struct _LogRecord {
+    int64_t         nTimeUs;    // wall clock, microseconds since the epoch
+    const char      *szFunc;    // string literal, only the pointer is kept
+    int             nLevel;
+    int             nHexLen;
+    char            szText[LOG_TEXT_LEN];
+    unsigned char   cHex[LOG_HEX_LEN];
+} LogRecord;
+
+class COasisLogger
+{
+public:
+    COasisLogger();
+    ~COasisLogger();
+
+    // the file is created (truncated) when the level first goes above LOG_LEVEL_OFF
+    void        setLogFile(const std::string &sPath);
+    void        setLevel(int nLevel);
+    int         getLevel() const        { return m_nLevel.load(std::memory_order_relaxed); }
+    bool        enabled(int nLevel) const { return nLevel <= m_nLevel.load(std::memory_order_relaxed); }
+
+    void        log(int nLevel, const char *szFunc, const char *szFormat, ...) LOG_PRINTF_FORMAT(4, 5);
+    // the text then the bytes, the hex formatting is left to the writer thread
+    void        logHex(int nLevel, const char *szFunc, const unsigned char *pData, int nLength, const char *szFormat, ...) LOG_PRINTF_FORMAT(6, 7);
+    uint64_t    getDropped() const      { return m_nDropped.load(std::memory_order_relaxed); }
+
+    // writer thread
+    void        writeRecords();
+    void        waitForRecords();
+    std::atomic<bool>   m_bStopWriter;
+
+protected:
+    void        push(const LogRecord &record);
+    void        writeRecord(const LogRecord &record);
+    void        startWriter();
+    void        stopWriter();
+
+    std::atomic<int>        m_nLevel;
+    std::mutex              m_ControlMutex;     // setLogFile, setLevel and the destructor, never taken by log()
+    std::string             m_sLogFilePath;
+    FILE                    *m_pLogFile;
+
+    CMpscQueue<LogRecord, LOG_QUEUE_SIZE>   m_Records;
+    std::atomic<uint64_t>   m_nDropped;
+    uint64_t                m_nDroppedReported;
+
+    std::thread             m_thWriter;
+    std::mutex              m_WriterMutex;      // only for the timed wait, producers don't signal
+    std::condition_variable m_WriterCond;
+};
+
+// the arguments aren't evaluated when the level is filtered out
+#define OasisLog(logger, level, ...)    do { if((logger).enabled(level)) (logger).log(level, __VA_ARGS__); } while(0)
+#define OasisLogHex(logger, level, ...) do { if((logger).enabled(level)) (logger).logHex(level, __VA_ARGS__); } while(0)
+
+#endif /* __OasisLogger__ */
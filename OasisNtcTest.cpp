@@ -0,0 +1,100 @@
+//
+//  OasisNtcTest.cpp
+//  Oasis X2 plugin
+//
+//  Checks the compile time NTC table against the runtime formula it replaced for every ADC value,
+//  built and run with "make check". -b times both over the whole ADC range, "make bench".
+//
+//  usage : oasis_ntctest [-b] [-n passes]
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <math.h>
+#include <unistd.h>
+
+#include "Oasis.h"
+
+#define NTCTEST_BENCH_PASSES    10000   // times the whole ADC range is converted with -b
+
+// GetNTCTemperature is protected, the test only needs to call it
+class CNtcController : public COasisController
+{
+public:
+    using COasisController::GetNTCTemperature;
+};
+
+// the runtime formula as it was before the table, float log and all
+__attribute__((noinline)) static int formulaNTCTemperature(int ad)
+{
+    if (ad <= 0)
+        ad = 1;
+    else if (ad >= AD_MAX)
+        ad = AD_MAX - 1;
+
+    float T = (float)(B / (log((AD_MAX - ad) / (float)ad) + B / T25) - K);
+    T += (T >= 0) ? 0.005f : -0.005f;
+    return (int)(T * 100);
+}
+
+int main(int argc, char *argv[])
+{
+    CNtcController controller;
+    bool bBench = false;
+    int nPasses = NTCTEST_BENCH_PASSES;
+    int nMismatches = 0;
+    int nPass;
+    int nOpt;
+    int ad;
+    int nTable;
+    int nFormula;
+    long nSum = 0;
+    double dFormulaNs;
+    double dTableNs;
+
+    while((nOpt = getopt(argc, argv, "bn:")) != -1) {
+        switch(nOpt) {
+            case 'b':
+                bBench = true;
+                break;
+            case 'n':
+                nPasses = std::max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-b] [-n passes]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // one past each end too, the clamping has to match as well
+    for(ad = -1; ad <= AD_MAX + 1; ad++) {
+        nTable = controller.GetNTCTemperature(ad);
+        nFormula = formulaNTCTemperature(ad);
+        if(nTable != nFormula) {
+            if(nMismatches < 10)
+                printf("FAIL ad %d : table %d, formula %d\n", ad, nTable, nFormula);
+            nMismatches++;
+        }
+    }
+    printf("%s %d ADC values, %d mismatch%s, %.2f C to %.2f C\n", nMismatches ? "FAIL" : "ok  ", AD_MAX + 3, nMismatches,
+           nMismatches == 1 ? "" : "es", controller.GetNTCTemperature(AD_MAX) * 0.01, controller.GetNTCTemperature(0) * 0.01);
+
+    if(bBench) {
+        auto start = std::chrono::steady_clock::now();
+        for(nPass = 0; nPass < nPasses; nPass++)
+            for(ad = 0; ad <= AD_MAX; ad++)
+                nSum += formulaNTCTemperature(ad);
+        dFormulaNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ((double)nPasses * (AD_MAX + 1));
+
+        start = std::chrono::steady_clock::now();
+        for(nPass = 0; nPass < nPasses; nPass++)
+            for(ad = 0; ad <= AD_MAX; ad++)
+                nSum -= controller.GetNTCTemperature(ad);
+        dTableNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ((double)nPasses * (AD_MAX + 1));
+
+        // nSum is back to 0 when both agree, and using it keeps the loops from being optimized away
+        printf("formula %.2f ns, table %.2f ns per conversion, %.1fx%s\n", dFormulaNs, dTableNs, dFormulaNs / dTableNs, nSum ? " (sums differ)" : "");
+    }
+
+    return nMismatches ? 1 : 0;
+}
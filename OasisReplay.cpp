@@ -0,0 +1,122 @@
+//
+//  OasisReplay.cpp
+//  Oasis X2 plugin
+//
+//  Offline replay of a FrameTrace file, built with "make replay".
+//  Every report the focuser sent is fed back through COasisController::parseResponse as fast as possible,
+//  no device needed, so a field trace can be reproduced, stepped through in a debugger or profiled.
+//
+//  usage : oasis_replay [-l log_level] [-n passes] Oasis-Trace-<serial>.bin
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <unistd.h>
+
+#include "Oasis.h"
+
+static int loadTrace(const char *szPath, TraceHeader &header, std::vector<TraceRecord> &records)
+{
+    FILE *pFile;
+    TraceRecord record;
+
+    pFile = fopen(szPath, "rb");
+    if(!pFile) {
+        fprintf(stderr, "can't open %s\n", szPath);
+        return ERR_CMDFAILED;
+    }
+
+    if(fread(&header, sizeof(header), 1, pFile) != 1 || memcmp(header.szMagic, TRACE_MAGIC, sizeof(header.szMagic)) || header.nRecordSize != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s isn't a trace file or was written by another version\n", szPath);
+        fclose(pFile);
+        return ERR_CMDFAILED;
+    }
+
+    // the ring may have wrapped, the sequence numbers give the order back
+    while(fread(&record, sizeof(record), 1, pFile) == 1) {
+        if(record.nSeq)
+            records.push_back(record);
+    }
+    fclose(pFile);
+
+    std::sort(records.begin(), records.end(), [](const TraceRecord &a, const TraceRecord &b) { return a.nSeq < b.nSeq; });
+    return PLUGIN_OK;
+}
+
+int main(int argc, char *argv[])
+{
+    TraceHeader header;
+    std::vector<TraceRecord> records;
+    Oasis_State state;
+    byte cReport[REPORT_SIZE];
+    int nLogLevel = LOG_LEVEL_OFF;
+    int nPasses = 1;
+    int nPass;
+    int nOpt;
+    long nRx = 0;
+    long nTx = 0;
+    double dTraceSeconds;
+    double dReplaySeconds;
+
+    while((nOpt = getopt(argc, argv, "l:n:")) != -1) {
+        switch(nOpt) {
+            case 'l':
+                nLogLevel = atoi(optarg);
+                break;
+            case 'n':
+                nPasses = std::max(1, atoi(optarg));
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-l log_level] [-n passes] trace_file\n", argv[0]);
+                return 1;
+        }
+    }
+    if(optind >= argc) {
+        fprintf(stderr, "usage : %s [-l log_level] [-n passes] trace_file\n", argv[0]);
+        return 1;
+    }
+
+    if(loadTrace(argv[optind], header, records))
+        return 1;
+    if(records.empty()) {
+        printf("%s is empty\n", argv[optind]);
+        return 0;
+    }
+
+    // not connected, parseResponse only updates the state and releases nobody
+    COasisController controller;
+    controller.setLogLevel(nLogLevel);
+
+    auto start = std::chrono::steady_clock::now();
+    for(nPass = 0; nPass < nPasses; nPass++) {
+        for(const TraceRecord &record : records) {
+            if(record.nDirection != TRACE_RX) {
+                nTx++;
+                continue;
+            }
+            memcpy(cReport, record.cReport, record.nLength);
+            controller.parseResponse(cReport, record.nLength);
+            nRx++;
+        }
+    }
+    dReplaySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    dTraceSeconds = (records.back().nTimeUs - records.front().nTimeUs) / 1e6;
+
+    printf("records        : %zu (first seq %u, last seq %u, %u written)\n", records.size(), records.front().nSeq, records.back().nSeq, (unsigned int)header.nWritten);
+    printf("replayed       : %ld reports in, %ld reports out skipped, %d pass(es)\n", nRx, nTx, nPasses);
+    printf("trace span     : %.3f s\n", dTraceSeconds);
+    printf("replay time    : %.6f s, %.0f ns per report", dReplaySeconds, nRx ? dReplaySeconds * 1e9 / nRx : 0.0);
+    if(dReplaySeconds > 0)
+        printf(", %.0fx real time", dTraceSeconds * nPasses / dReplaySeconds);
+    printf("\n");
+
+    controller.getState(state);
+    printf("final state    : position %d/%d, %s, internal %.2f C, ambient %.2f C%s\n",
+           state.nCurPos, state.nMaxPos, state.bIsMoving ? "moving" : "stopped",
+           state.fInternal, state.fAmbient, state.bExternalSensorPresent ? "" : " (no probe)");
+    printf("firmware       : %s\n", state.sVersion.c_str());
+    return 0;
+}
@@ -0,0 +1,205 @@
+//
+//  OasisSimTest.cpp
+//  Oasis X2 plugin
+//
+//  End to end check of COasisController against the in process simulator, built and run with "make check".
+//  Connects, moves at every speed setting, halts a move midway and as soon as it's sent, syncs the position and
+//  toggles the external probe, checking what the controller reports after each step. No device needed.
+//
+//  usage : oasis_simtest [-l log_level]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstdarg>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+
+#include "Oasis.h"
+#include "OasisDriver.h"
+
+#define SIMTEST_MOVE_STEPS      500     // steps at the slowest speed, doubled for each faster one so every move takes about 2 s
+#define SIMTEST_HALT_TARGET     50000   // far enough that the move is still running when it's halted
+#define SIMTEST_HALT_AFTER      300     // ms into the move
+#define SIMTEST_HALT_STOP_MAX   1000    // ms, halt call to stopped status. Braking from the fastest speed plus a fast status poll
+#define SIMTEST_HALT_AT_START_MAX 500   // steps, a move halted as soon as the goto returns ends within this
+#define SIMTEST_HALT_SETTLE     1000    // ms, long enough for a move that wasn't halted to show up in the status
+
+static int nFailures = 0;
+
+static void check(bool bOk, const char *szFormat, ...)
+{
+    va_list args;
+
+    printf("%s ", bOk ? "ok  " : "FAIL");
+    va_start(args, szFormat);
+    vprintf(szFormat, args);
+    va_end(args);
+    printf("\n");
+    if(!bOk)
+        nFailures++;
+}
+
+static void testConnect(COasisController &controller)
+{
+    std::vector<std::string> focuserSNList;
+    std::string sVersion;
+    int nErr;
+
+    controller.listFocusers(focuserSNList);
+    check(focuserSNList.size() == 1 && focuserSNList[0] == SIM_SERIAL, "listFocusers returns the simulator");
+
+    nErr = controller.Connect();
+    check(nErr == PLUGIN_OK && controller.IsConnected(), "Connect returns %d", nErr);
+    check(controller.getActiveTransport() == TRANSPORT_SIMULATOR, "active transport is the simulator");
+    check(controller.getPosLimit() == SIM_MAX_STEP, "position limit %u", (unsigned int)controller.getPosLimit());
+    controller.getVersions(sVersion);
+    check(sVersion.size() != 0, "firmware version '%s'", sVersion.c_str());
+}
+
+static void testSpeeds(COasisController &controller)
+{
+    COasisConfigTransaction config;
+    double fMs = 0;
+    double fRate;
+    double fPrevRate = 0;
+    long nSteps;
+    long nTarget;
+    int nSpeed;
+    int nErr;
+
+    // slowest first, every speed has to cover ground faster than the one before it
+    for(nSpeed = 0; nSpeed < SIM_SPEEDS; nSpeed++) {
+        config = COasisConfigTransaction();
+        config.setSpeed((uint8_t)nSpeed);
+        nErr = controller.commitConfig(config);
+        check(nErr == PLUGIN_OK && controller.getSpeed() == (uint32_t)nSpeed, "speed %d set, commitConfig returns %d", nSpeed, nErr);
+
+        nSteps = (long)SIMTEST_MOVE_STEPS << nSpeed;
+        nTarget = controller.getPosition() + nSteps;
+        nErr = runGoto(controller, nTarget, fMs);
+        fRate = nSteps * 1000.0 / fMs;
+        check(nErr == PLUGIN_OK && controller.getPosition() == (uint32_t)nTarget, "speed %d goto %ld ends at %u in %.0f ms, %.0f steps/s",
+              nSpeed, nTarget, (unsigned int)controller.getPosition(), fMs, fRate);
+        if(nSpeed)
+            check(fRate > fPrevRate, "speed %d is faster than speed %d", nSpeed, nSpeed - 1);
+        fPrevRate = fRate;
+    }
+}
+
+static void testHalt(COasisController &controller)
+{
+    std::chrono::steady_clock::time_point start;
+    double fStopMs;
+    bool bStopped;
+    int nLastUs;
+    int nMaxUs;
+    int nErr;
+
+    nErr = controller.gotoPosition(SIMTEST_HALT_TARGET);
+    check(nErr == PLUGIN_OK, "goto %d returns %d", SIMTEST_HALT_TARGET, nErr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SIMTEST_HALT_AFTER));
+    check(waitForState(controller, DRIVER_STATE_TIMEOUT, [](const Oasis_State &state) { return state.bIsMoving; }), "focuser is moving");
+
+    start = std::chrono::steady_clock::now();
+    nErr = controller.haltFocuser();
+    check(nErr == PLUGIN_OK, "haltFocuser returns %d", nErr);
+    bStopped = waitForStop(controller);
+    fStopMs = elapsedMs(start);
+    check(bStopped && controller.getPosition() < SIMTEST_HALT_TARGET, "stopped short of the target at %u", (unsigned int)controller.getPosition());
+    check(fStopMs < SIMTEST_HALT_STOP_MAX, "halt to stopped in %.0f ms, bound %d ms", fStopMs, SIMTEST_HALT_STOP_MAX);
+
+    // the halt jumps the command queue, it has to reach the device within the I/O thread's wake up bound
+    controller.getHaltLatency(nLastUs, nMaxUs);
+    check(nLastUs > 0 && nMaxUs <= HIDAPI_READ_TIMEOUT * 1000, "halt request to write %d us, worst %d us, bound %d us",
+          nLastUs, nMaxUs, HIDAPI_READ_TIMEOUT * 1000);
+}
+
+// TheSkyX's abort right after the goto call, before any status has reported the move
+static void testHaltAtStart(COasisController &controller)
+{
+    std::chrono::steady_clock::time_point start;
+    double fStopMs;
+    bool bStopped;
+    uint32_t nStartPos;
+    int nErr;
+
+    nStartPos = controller.getPosition();
+    nErr = controller.gotoPosition(SIMTEST_HALT_TARGET);
+    check(nErr == PLUGIN_OK, "goto %d returns %d", SIMTEST_HALT_TARGET, nErr);
+
+    start = std::chrono::steady_clock::now();
+    nErr = controller.haltFocuser();
+    fStopMs = elapsedMs(start);
+    check(nErr == PLUGIN_OK, "haltFocuser right after the goto returns %d in %.0f ms", nErr, fStopMs);
+
+    // the state still says stopped from before the goto, give a move that wasn't halted time to show up
+    std::this_thread::sleep_for(std::chrono::milliseconds(SIMTEST_HALT_SETTLE));
+    bStopped = waitForStop(controller);
+    check(bStopped && controller.getPosition() < nStartPos + SIMTEST_HALT_AT_START_MAX, "stopped at %u, %u steps after the start, bound %d",
+          (unsigned int)controller.getPosition(), (unsigned int)(controller.getPosition() - nStartPos), SIMTEST_HALT_AT_START_MAX);
+}
+
+static void testSync(COasisController &controller)
+{
+    uint32_t nSyncPos;
+    bool bSynced;
+    int nErr;
+
+    nSyncPos = controller.getPosition() + 1234;
+    nErr = controller.setPosition(nSyncPos);
+    check(nErr == PLUGIN_OK, "setPosition %u returns %d", (unsigned int)nSyncPos, nErr);
+    bSynced = waitForState(controller, DRIVER_STATE_TIMEOUT, [nSyncPos](const Oasis_State &state) { return state.nCurPos == nSyncPos; });
+    check(bSynced, "position synced to %u", (unsigned int)controller.getPosition());
+}
+
+static void testProbe(COasisController &controller)
+{
+    controller.setSimulatorProbe(false);
+    check(waitForState(controller, DRIVER_STATE_TIMEOUT, [](const Oasis_State &state) { return !state.bExternalSensorPresent; }),
+          "probe unplugged");
+
+    controller.setSimulatorProbe(true);
+    check(waitForState(controller, DRIVER_STATE_TIMEOUT, [](const Oasis_State &state) { return state.bExternalSensorPresent; }),
+          "probe plugged in");
+    check(fabs(controller.getTemperature(EXTERNAL) - SIM_AMBIENT_TEMP) < 0.1, "probe reads %.2f C", controller.getTemperature(EXTERNAL));
+    check(fabs(controller.getTemperature(INTERNAL) - SIM_INTERNAL_TEMP) < 0.1, "internal sensor reads %.2f C", controller.getTemperature(INTERNAL));
+}
+
+int main(int argc, char *argv[])
+{
+    COasisController controller;
+    int nLogLevel = LOG_LEVEL_OFF;
+    int nOpt;
+
+    while((nOpt = getopt(argc, argv, "l:")) != -1) {
+        switch(nOpt) {
+            case 'l':
+                nLogLevel = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage : %s [-l log_level]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    controller.setLogLevel(nLogLevel);
+    controller.setTransport(TRANSPORT_SIMULATOR);
+    controller.setSimulatorProbe(true);
+
+    testConnect(controller);
+    if(!controller.IsConnected())
+        return 1;
+    testSpeeds(controller);
+    testHalt(controller);
+    testHaltAtStart(controller);
+    testSync(controller);
+    testProbe(controller);
+
+    controller.Disconnect();
+    check(!controller.IsConnected(), "Disconnect");
+
+    printf("%d failure%s\n", nFailures, nFailures == 1 ? "" : "s");
+    return nFailures ? 1 : 0;
+}
@@ -0,0 +1,572 @@
+//
+//  OasisSimulator.cpp
+//  Oasis X2 plugin
+//
+//  In process focuser firmware, see OasisSimulator.h
+
+#include <cmath>
+#include <algorithm>
+
+#include "Oasis.h"
+
+// steps per second at full speed for each speed setting
+static const double SimStepRates[SIM_SPEEDS] = {250.0, 500.0, 1000.0, 2000.0, 4000.0};
+
+// the name frames only differ by their type. FrameSetBytes/FrameBytes spelled out, T is a dependent type here
+template <typename T>
+static void writeNameFrame(unsigned char *cReport, unsigned char nCode, const std::string &sName)
+{
+    CFrameWriter<T> frame(cReport, nCode);
+    frame.template setBytes<T, offsetof(T, data), sizeof(T::data)>(sName.c_str(), sName.size());
+}
+
+template <typename T>
+static bool readNameFrame(const unsigned char *pFrame, int nLength, std::string &sName)
+{
+    CFrameView<T, sizeof(FrameHead)> view(pFrame, nLength);
+    const char *pData;
+    size_t nDataLen;
+
+    if(!view.valid())
+        return false;
+    pData = view.template bytes<T, offsetof(T, data), sizeof(T::data)>(nDataLen);
+    sName.assign(pData, strnlen(pData, nDataLen));
+    return true;
+}
+
+COasisSimulator::COasisSimulator(COasisLogger &logger) : m_Logger(logger)
+{
+    m_bOpen = false;
+    m_bWake = false;
+
+    m_nPosition = 0;
+    m_bMoving = false;
+    m_Move = SimMove();
+    m_nLastDirection = 0;
+
+    m_nMaxStep = SIM_MAX_STEP;
+    m_nBacklash = 0;
+    m_nBacklashDirection = 0;
+    m_nReverse = 0;
+    m_nSpeed = 2;
+    m_nBeepOnMove = 0;
+    m_nBeepOnStartup = 0;
+    m_nBluetoothOn = 0;
+    m_nUserID = 0;
+    m_sFriendlyName = "Oasis Simulator";
+    m_sBluetoothName = "Oasis-Sim";
+
+    m_bProbePresent = false;
+    m_fInternal = SIM_INTERNAL_TEMP;
+    m_fAmbient = SIM_AMBIENT_TEMP;
+}
+
+COasisSimulator::~COasisSimulator()
+{
+    close();
+}
+
+bool COasisSimulator::open(std::string &sSerial)
+{
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+
+    if(sSerial.size() && sSerial != SIM_SERIAL) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "COasisSimulator::open", "no simulated focuser with serial %s", sSerial.c_str());
+        return false;
+    }
+    sSerial.assign(SIM_SERIAL);
+    m_Replies.clear();
+    m_bWake = false;
+    m_bOpen = true;
+    OasisLog(m_Logger, LOG_LEVEL_INFO, "COasisSimulator::open", "simulated focuser %s, position %d", SIM_SERIAL, (int)m_nPosition);
+    return true;
+}
+
+void COasisSimulator::close()
+{
+    {
+        const std::lock_guard<std::mutex> lock(m_Mutex);
+        // like unplugging the cable, a move in progress still completes
+        m_bOpen = false;
+        m_Replies.clear();
+    }
+    m_Cond.notify_all();
+}
+
+int COasisSimulator::write(const unsigned char *cReport, int nLength)
+{
+    if(nLength < 1)
+        return -1;
+
+    {
+        const std::lock_guard<std::mutex> lock(m_Mutex);
+        if(!m_bOpen)
+            return -1;
+        updateMotion(std::chrono::steady_clock::now());
+        // skip the report ID, same as the device
+        handleFrame(cReport + 1, std::min(nLength - 1, FRAME_MAX_LEN));
+    }
+    m_Cond.notify_all();
+    return nLength;
+}
+
+int COasisSimulator::read(unsigned char *cReport, int nLength, int nTimeoutMs)
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    std::chrono::steady_clock::time_point now;
+    std::chrono::steady_clock::time_point deadline;
+    std::chrono::steady_clock::time_point wakeTime;
+    int nRead;
+
+    now = std::chrono::steady_clock::now();
+    deadline = now + std::chrono::milliseconds(nTimeoutMs < 0 ? 0 : nTimeoutMs);
+
+    while(true) {
+        if(!m_bOpen)
+            return -1;
+        if(m_bWake) {
+            m_bWake = false;
+            return 0;
+        }
+        now = std::chrono::steady_clock::now();
+        if(m_Replies.size() && m_Replies.front().readyTime <= now) {
+            nRead = std::min(nLength, m_Replies.front().nLength);
+            memcpy(cReport, m_Replies.front().cFrame, nRead);
+            m_Replies.pop_front();
+            return nRead;
+        }
+        if(nTimeoutMs >= 0 && now >= deadline)
+            return 0;
+
+        // sleep until the next reply is out of the "cable", the deadline or a wake up, whichever comes first
+        if(m_Replies.size()) {
+            wakeTime = m_Replies.front().readyTime;
+            if(nTimeoutMs >= 0 && deadline < wakeTime)
+                wakeTime = deadline;
+            m_Cond.wait_until(lock, wakeTime);
+        }
+        else if(nTimeoutMs >= 0)
+            m_Cond.wait_until(lock, deadline);
+        else
+            m_Cond.wait(lock);
+    }
+}
+
+void COasisSimulator::wake()
+{
+    {
+        const std::lock_guard<std::mutex> lock(m_Mutex);
+        m_bWake = true;
+    }
+    m_Cond.notify_all();
+}
+
+void COasisSimulator::setProbePresent(bool bPresent)
+{
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_bProbePresent = bPresent;
+}
+
+void COasisSimulator::setTemperatures(float fInternal, float fAmbient)
+{
+    const std::lock_guard<std::mutex> lock(m_Mutex);
+    m_fInternal = fInternal;
+    m_fAmbient = fAmbient;
+}
+
+double COasisSimulator::stepRate(uint8_t nSpeed)
+{
+    return SimStepRates[std::min((int)nSpeed, SIM_SPEEDS - 1)];
+}
+
+#pragma mark firmware
+
+// called with m_Mutex held, pFrame starts at the frame code
+void COasisSimulator::handleFrame(const unsigned char *pFrame, int nLength)
+{
+    unsigned char nCode;
+    std::string sName;
+
+    if(nLength < (int)sizeof(FrameHead))
+        return;
+    nCode = pFrame[0];
+    OasisLog(m_Logger, LOG_LEVEL_DEBUG, "COasisSimulator::handleFrame", "code 0x%02X", (int)nCode);
+
+    switch(nCode) {
+        case CODE_GET_PRODUCT_MODEL :
+            replyName(nCode, "Oasis Focuser Simulator");
+            break;
+        case CODE_GET_VERSION :
+            replyVersion();
+            break;
+        case CODE_GET_SERIAL_NUMBER :
+            replyName(nCode, SIM_SERIAL);
+            break;
+        case CODE_GET_FRIENDLY_NAME :
+            replyName(nCode, m_sFriendlyName);
+            break;
+        case CODE_SET_FRIENDLY_NAME :
+            if(!readNameFrame<FrameFriendlyName>(pFrame, nLength, sName)) {
+                queueAck(nCode, 1);
+                break;
+            }
+            m_sFriendlyName = sName;
+            queueAck(nCode, 0);
+            break;
+        case CODE_GET_BLUETOOTH_NAME :
+            replyName(nCode, m_sBluetoothName);
+            break;
+        case CODE_SET_BLUETOOTH_NAME :
+            if(!readNameFrame<FrameBluetoothName>(pFrame, nLength, sName)) {
+                queueAck(nCode, 1);
+                break;
+            }
+            m_sBluetoothName = sName;
+            queueAck(nCode, 0);
+            break;
+        case CODE_GET_USER_ID :
+            {
+                unsigned char cReport[REPORT_SIZE];
+                CFrameWriter<FrameUserID> frame(cReport, nCode);
+                FrameSet(frame, FrameUserID, userID, m_nUserID);
+                queueReply(cReport);
+            }
+            break;
+        case CODE_SET_USER_ID :
+            {
+                CFrameView<FrameUserID> view(pFrame, nLength);
+                if(view.valid())
+                    m_nUserID = FrameGet(view, FrameUserID, userID);
+                queueAck(nCode, view.valid() ? 0 : 1);
+            }
+            break;
+        case CODE_GET_CONFIG :
+            replyConfig();
+            break;
+        case CODE_SET_CONFIG :
+            setConfig(pFrame, nLength);
+            break;
+        case CODE_GET_STATUS :
+            replyStatus();
+            break;
+        case CODE_CMD_FACTORY_RESET :
+            m_nMaxStep = SIM_MAX_STEP;
+            m_nBacklash = 0;
+            m_nBacklashDirection = 0;
+            m_nReverse = 0;
+            m_nSpeed = 2;
+            m_nBeepOnMove = 0;
+            m_nBeepOnStartup = 0;
+            m_nBluetoothOn = 0;
+            queueAck(nCode, 0);
+            break;
+        case CODE_SET_ZERO_POSITION :
+            if(!m_bMoving)
+                m_nPosition = 0;
+            queueAck(nCode, m_bMoving ? 1 : 0);
+            break;
+        case CODE_CMD_MOVE_STEP :
+            {
+                // direction 0 is inward, toward 0
+                CFrameView<FrameMove> view(pFrame, nLength);
+                int64_t nSteps;
+                if(!view.valid()) {
+                    queueAck(nCode, 1);
+                    break;
+                }
+                nSteps = FrameGet(view, FrameMove, step);
+                startMove(m_nPosition + (FrameGet(view, FrameMove, direction) ? nSteps : -nSteps));
+                queueAck(nCode, 0);
+            }
+            break;
+        case CODE_CMD_MOVE_TO :
+            {
+                CFrameView<FrameMoveTo> view(pFrame, nLength);
+                if(!view.valid()) {
+                    queueAck(nCode, 1);
+                    break;
+                }
+                startMove(FrameGet(view, FrameMoveTo, position));
+                queueAck(nCode, 0);
+            }
+            break;
+        case CODE_CMD_STOP_MOVE :
+            stopMove();
+            queueAck(nCode, 0);
+            break;
+        case CODE_CMD_SYNC_POSITION :
+            {
+                CFrameView<FrameSyncPosition> view(pFrame, nLength);
+                if(!view.valid() || m_bMoving) {
+                    queueAck(nCode, 1);
+                    break;
+                }
+                m_nPosition = FrameGet(view, FrameSyncPosition, position);
+                queueAck(nCode, 0);
+            }
+            break;
+        default :
+            // firmware upgrade and the factory commands aren't simulated
+            OasisLog(m_Logger, LOG_LEVEL_INFO, "COasisSimulator::handleFrame", "code 0x%02X isn't simulated", (int)nCode);
+            queueAck(nCode, 1);
+            break;
+    }
+}
+
+void COasisSimulator::queueReply(const unsigned char *cReport)
+{
+    SimReport report;
+
+    report.readyTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(SIM_REPLY_LATENCY);
+    report.nLength = FRAME_MAX_LEN;
+    memcpy(report.cFrame, cReport + 1, FRAME_MAX_LEN);
+    m_Replies.push_back(report);
+}
+
+void COasisSimulator::queueAck(unsigned char nCode, unsigned char nResult)
+{
+    unsigned char cReport[REPORT_SIZE];
+
+    CFrameWriter<FrameCommandAck> frame(cReport, nCode);
+    FrameSet(frame, FrameCommandAck, result, nResult);
+    queueReply(cReport);
+}
+
+void COasisSimulator::replyStatus()
+{
+    unsigned char cReport[REPORT_SIZE];
+
+    CFrameWriter<FrameStatusAck> frame(cReport, CODE_GET_STATUS);
+    FrameSet(frame, FrameStatusAck, temperatureInt, ntcCounts(m_fInternal));
+    // the probe reports 1/16 C as a signed 16 bit value
+    FrameSet(frame, FrameStatusAck, temperatureExt, m_bProbePresent ? (uint16_t)(int16_t)lroundf(m_fAmbient * 16) : 0);
+    FrameSet(frame, FrameStatusAck, temperatureDetection, m_bProbePresent ? 1 : 0);
+    FrameSet(frame, FrameStatusAck, moving, m_bMoving ? 1 : 0);
+    FrameSet(frame, FrameStatusAck, position, (uint32_t)std::max<int64_t>(m_nPosition, 0));
+    queueReply(cReport);
+}
+
+void COasisSimulator::replyConfig()
+{
+    unsigned char cReport[REPORT_SIZE];
+
+    CFrameWriter<FrameConfig> frame(cReport, CODE_GET_CONFIG);
+    FrameSet(frame, FrameConfig, mask, MASK_ALL);
+    FrameSet(frame, FrameConfig, maxStep, m_nMaxStep);
+    FrameSet(frame, FrameConfig, backlash, m_nBacklash);
+    FrameSet(frame, FrameConfig, backlashDirection, m_nBacklashDirection);
+    FrameSet(frame, FrameConfig, reverseDirection, m_nReverse);
+    FrameSet(frame, FrameConfig, speed, m_nSpeed);
+    FrameSet(frame, FrameConfig, beepOnMove, m_nBeepOnMove);
+    FrameSet(frame, FrameConfig, beepOnStartup, m_nBeepOnStartup);
+    FrameSet(frame, FrameConfig, bluetoothOn, m_nBluetoothOn);
+    queueReply(cReport);
+}
+
+void COasisSimulator::replyVersion()
+{
+    unsigned char cReport[REPORT_SIZE];
+    const char szBuilt[] = "simulator";
+
+    CFrameWriter<FrameVersionAck> frame(cReport, CODE_GET_VERSION);
+    FrameSet(frame, FrameVersionAck, protocal, 0x01000000);
+    FrameSet(frame, FrameVersionAck, hardware, 0x01000000);
+    FrameSet(frame, FrameVersionAck, firmware, 0x01000000);
+    FrameSetBytes(frame, FrameVersionAck, built, szBuilt, sizeof(szBuilt) - 1);
+    queueReply(cReport);
+}
+
+void COasisSimulator::replyName(unsigned char nCode, const std::string &sName)
+{
+    unsigned char cReport[REPORT_SIZE];
+
+    switch(nCode) {
+        case CODE_GET_PRODUCT_MODEL :
+            writeNameFrame<FrameProductModelAck>(cReport, nCode, sName);
+            break;
+        case CODE_GET_SERIAL_NUMBER :
+            writeNameFrame<FrameSerialNumber>(cReport, nCode, sName);
+            break;
+        case CODE_GET_FRIENDLY_NAME :
+            writeNameFrame<FrameFriendlyName>(cReport, nCode, sName);
+            break;
+        default :
+            writeNameFrame<FrameBluetoothName>(cReport, nCode, sName);
+            break;
+    }
+    queueReply(cReport);
+}
+
+void COasisSimulator::setConfig(const unsigned char *pFrame, int nLength)
+{
+    CFrameView<FrameConfig> view(pFrame, nLength);
+    uint32_t nMask;
+
+    if(!view.valid()) {
+        queueAck(CODE_SET_CONFIG, 1);
+        return;
+    }
+
+    nMask = FrameGet(view, FrameConfig, mask);
+    if(nMask & MASK_MAX_STEP)
+        m_nMaxStep = FrameGet(view, FrameConfig, maxStep);
+    if(nMask & MASK_BACKLASH)
+        m_nBacklash = FrameGet(view, FrameConfig, backlash);
+    if(nMask & MASK_BACKLASH_DIRECTION)
+        m_nBacklashDirection = FrameGet(view, FrameConfig, backlashDirection);
+    if(nMask & MASK_REVERSE_DIRECTION)
+        m_nReverse = FrameGet(view, FrameConfig, reverseDirection);
+    if(nMask & MASK_SPEED)
+        m_nSpeed = FrameGet(view, FrameConfig, speed);
+    if(nMask & MASK_BEEP_ON_MOVE)
+        m_nBeepOnMove = FrameGet(view, FrameConfig, beepOnMove);
+    if(nMask & MASK_BEEP_ON_STARTUP)
+        m_nBeepOnStartup = FrameGet(view, FrameConfig, beepOnStartup);
+    if(nMask & MASK_BLUETOOTH)
+        m_nBluetoothOn = FrameGet(view, FrameConfig, bluetoothOn);
+    queueAck(CODE_SET_CONFIG, 0);
+}
+
+#pragma mark motion
+
+// called with m_Mutex held and the motion up to date. A move in progress is replaced, keeping its speed if
+// it goes the same way.
+void COasisSimulator::startMove(int64_t nTarget)
+{
+    double fDistance;
+    double fSpeed = 0;
+    double fDuration;
+    int nDirection;
+
+    nTarget = std::max<int64_t>(0, std::min<int64_t>(nTarget, m_nMaxStep));
+    if(nTarget == m_nPosition)
+        return;
+    nDirection = nTarget > m_nPosition ? 1 : -1;
+
+    if(m_bMoving) {
+        moveState(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Move.startTime).count(), fDistance, fSpeed, fDuration);
+        if(nDirection != m_nLastDirection)
+            fSpeed = 0;
+    }
+
+    m_Move.startTime = std::chrono::steady_clock::now();
+    m_Move.nStart = m_nPosition;
+    m_Move.nTarget = nTarget;
+    // backlash compensation : moves against the backlash direction go past the target and come back to it
+    m_Move.nExtraSteps = (m_nBacklash && nDirection != (m_nBacklashDirection ? 1 : -1)) ? m_nBacklash : 0;
+    m_Move.fMaxSpeed = stepRate(m_nSpeed);
+    // can't brake harder than SIM_ACCELERATION, the ramp down starts right away in that case
+    m_Move.fStartSpeed = std::min(fSpeed, sqrt(2.0 * SIM_ACCELERATION * (double)(llabs(nTarget - m_nPosition) + 2 * m_Move.nExtraSteps)));
+    m_nLastDirection = nDirection;
+    m_bMoving = true;
+}
+
+// decelerates to a stop from wherever the motor is, like the firmware does
+void COasisSimulator::stopMove()
+{
+    double fDistance;
+    double fSpeed;
+    double fDuration;
+    double fFirstLeg;
+    int nDirection;
+    int64_t nBrake;
+
+    if(!m_bMoving)
+        return;
+
+    moveState(std::chrono::duration<double>(std::chrono::steady_clock::now() - m_Move.startTime).count(), fDistance, fSpeed, fDuration);
+    nDirection = m_Move.nTarget > m_Move.nStart ? 1 : -1;
+    fFirstLeg = (double)(llabs(m_Move.nTarget - m_Move.nStart) + m_Move.nExtraSteps);
+    if(fDistance > fFirstLeg)
+        nDirection = -nDirection; // coming back from the backlash overshoot
+
+    nBrake = (int64_t)ceil(fSpeed * fSpeed / (2.0 * SIM_ACCELERATION));
+    if(!nBrake) {
+        m_bMoving = false;
+        return;
+    }
+    m_Move.startTime = std::chrono::steady_clock::now();
+    m_Move.nStart = m_nPosition;
+    m_Move.nTarget = std::max<int64_t>(0, std::min<int64_t>(m_nPosition + nDirection * nBrake, m_nMaxStep));
+    m_Move.nExtraSteps = 0;
+    m_Move.fStartSpeed = fSpeed;
+    m_Move.fMaxSpeed = fSpeed;
+    m_nLastDirection = nDirection;
+    if(m_Move.nTarget == m_nPosition)
+        m_bMoving = false;
+}
+
+// called with m_Mutex held, advances m_nPosition to where the motor is at 'now'
+void COasisSimulator::updateMotion(std::chrono::steady_clock::time_point now)
+{
+    double fElapsed;
+    double fDistance;
+    double fSpeed;
+    double fDuration;
+    double fFirstLeg;
+    int nDirection;
+
+    if(!m_bMoving)
+        return;
+
+    fElapsed = std::chrono::duration<double>(now - m_Move.startTime).count();
+    moveState(fElapsed, fDistance, fSpeed, fDuration);
+    if(fElapsed >= fDuration) {
+        m_nPosition = m_Move.nTarget;
+        m_bMoving = false;
+        return;
+    }
+
+    nDirection = m_Move.nTarget > m_Move.nStart ? 1 : -1;
+    fFirstLeg = (double)(llabs(m_Move.nTarget - m_Move.nStart) + m_Move.nExtraSteps);
+    if(fDistance > fFirstLeg)
+        fDistance = 2 * fFirstLeg - fDistance;
+    m_nPosition = m_Move.nStart + nDirection * (int64_t)fDistance;
+}
+
+// trapezoidal profile over the whole travel, overshoot included. Returns the distance covered and the speed
+// fElapsed seconds after the start, and how long the move takes. The speed is 0 once it's over.
+void COasisSimulator::moveState(double fElapsed, double &fDistance, double &fSpeed, double &fDuration) const
+{
+    const double a = SIM_ACCELERATION;
+    double fTotal = (double)(llabs(m_Move.nTarget - m_Move.nStart) + 2 * m_Move.nExtraSteps);
+    double v0 = m_Move.fStartSpeed;
+    double vp;
+    double tAcc, dAcc, tCruise, dCruise, tDec, t;
+
+    vp = std::min(m_Move.fMaxSpeed, sqrt((2.0 * a * fTotal + v0 * v0) / 2.0));
+    vp = std::max(vp, v0);
+    tAcc = (vp - v0) / a;
+    dAcc = (vp * vp - v0 * v0) / (2.0 * a);
+    tDec = vp / a;
+    dCruise = std::max(0.0, fTotal - dAcc - vp * vp / (2.0 * a));
+    tCruise = vp > 0 ? dCruise / vp : 0;
+    fDuration = tAcc + tCruise + tDec;
+
+    if(fElapsed >= fDuration) {
+        fDistance = fTotal;
+        fSpeed = 0;
+    }
+    else if(fElapsed < tAcc) {
+        fDistance = v0 * fElapsed + 0.5 * a * fElapsed * fElapsed;
+        fSpeed = v0 + a * fElapsed;
+    }
+    else if(fElapsed < tAcc + tCruise) {
+        fDistance = dAcc + vp * (fElapsed - tAcc);
+        fSpeed = vp;
+    }
+    else {
+        t = fElapsed - tAcc - tCruise;
+        fDistance = dAcc + dCruise + vp * t - 0.5 * a * t * t;
+        fSpeed = vp - a * t;
+    }
+    fDistance = std::min(fDistance, fTotal);
+}
+
+// ADC reading of the internal NTC at fTemperature, the inverse of GetNTCTemperature
+int COasisSimulator::ntcCounts(float fTemperature) const
+{
+    double fRatio = exp(B / (fTemperature + K) - B / T25);
+
+    return (int)lround(AD_MAX / (1.0 + fRatio));
+}
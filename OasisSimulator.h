@@ -0,0 +1,115 @@
+//
+//  OasisSimulator.h
+//  Oasis X2 plugin
+//
+//  In process Oasis firmware behind the COasisTransport interface, selected with TRANSPORT_SIMULATOR.
+//  Every command in protocol.h that the plugin uses is answered the way the focuser does : status, config,
+//  move to, move step, stop, sync, zero, the names, model and version. Moves follow a trapezoidal profile
+//  with the step rate of the current speed setting, so polling, goto completion and halts see realistic timing.
+//  The external temperature probe can be plugged or unplugged at any time.
+
+#ifndef __OasisSimulator__
+#define __OasisSimulator__
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+
+#include "FrameCodec.h"
+#include "OasisTransport.h"
+
+#define SIM_SERIAL          "OASIS-SIM-0001"
+#define SIM_REPLY_LATENCY   1       // ms, USB round trip before a reply can be read
+#define SIM_MAX_STEP        100000  // default travel
+#define SIM_ACCELERATION    8000    // steps/s^2, same ramp up and down at every speed
+#define SIM_SPEEDS          5       // speed settings, higher is faster. Larger values use the fastest one
+#define SIM_INTERNAL_TEMP   20.0f   // C
+#define SIM_AMBIENT_TEMP    12.5f   // C
+
+typedef struct _SimReport {
+    std::chrono::steady_clock::time_point   readyTime;
+    int             nLength;
+    unsigned char   cFrame[FRAME_MAX_LEN];
+} SimReport;
+
+// one move, from nStart to nTarget. Starts at fStartSpeed, ramps up to fMaxSpeed and back down to 0 at the target
+typedef struct _SimMove {
+    std::chrono::steady_clock::time_point   startTime;
+    int64_t         nStart;
+    int64_t         nTarget;
+    uint32_t        nExtraSteps;    // backlash compensation, travelled past the target and back
+    double          fStartSpeed;    // steps/s
+    double          fMaxSpeed;      // steps/s
+} SimMove;
+
+class COasisSimulator : public COasisTransport
+{
+public:
+    COasisSimulator(COasisLogger &logger);
+    ~COasisSimulator();
+
+    bool        open(std::string &sSerial) override;
+    void        close() override;
+    bool        isOpen() const override     { return m_bOpen; }
+    int         write(const unsigned char *cReport, int nLength) override;
+    int         read(unsigned char *cReport, int nLength, int nTimeoutMs) override;
+    void        wake() override;
+    int         type() const override       { return TRANSPORT_SIMULATOR; }
+
+    // test and demo controls, safe from any thread
+    void        setProbePresent(bool bPresent);
+    void        setTemperatures(float fInternal, float fAmbient);
+    static double stepRate(uint8_t nSpeed);
+
+protected:
+    void        handleFrame(const unsigned char *pFrame, int nLength);
+    void        queueReply(const unsigned char *cReport);
+    void        queueAck(unsigned char nCode, unsigned char nResult);
+    void        replyStatus();
+    void        replyConfig();
+    void        replyVersion();
+    void        replyName(unsigned char nCode, const std::string &sName);
+    void        setConfig(const unsigned char *pFrame, int nLength);
+
+    void        startMove(int64_t nTarget);
+    void        stopMove();
+    void        updateMotion(std::chrono::steady_clock::time_point now);
+    void        moveState(double fElapsed, double &fDistance, double &fSpeed, double &fDuration) const;
+    int         ntcCounts(float fTemperature) const;
+
+    COasisLogger        &m_Logger;
+
+    // firmware state, m_Mutex protects everything below
+    std::mutex          m_Mutex;
+    std::condition_variable m_Cond;
+    std::atomic<bool>   m_bOpen;
+    bool                m_bWake;
+    std::deque<SimReport> m_Replies;
+
+    int64_t             m_nPosition;
+    bool                m_bMoving;
+    SimMove             m_Move;
+    int                 m_nLastDirection;   // 1 outward, -1 inward, 0 before the first move
+
+    uint32_t            m_nMaxStep;
+    uint32_t            m_nBacklash;
+    uint8_t             m_nBacklashDirection;
+    uint8_t             m_nReverse;
+    uint8_t             m_nSpeed;
+    uint8_t             m_nBeepOnMove;
+    uint8_t             m_nBeepOnStartup;
+    uint8_t             m_nBluetoothOn;
+    uint32_t            m_nUserID;
+    std::string         m_sFriendlyName;
+    std::string         m_sBluetoothName;
+
+    bool                m_bProbePresent;
+    float               m_fInternal;
+    float               m_fAmbient;
+};
+
+#endif /* __OasisSimulator__ */
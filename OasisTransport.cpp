@@ -0,0 +1,301 @@
+//
+//  OasisTransport.cpp
+//  Oasis X2 plugin
+//
+//  USB transports, see OasisTransport.h
+
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+
+#ifdef SB_LINUX_BUILD
+#include <fstream>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#endif
+
+#include "OasisTransport.h"
+
+#pragma mark - CHidapiTransport
+
+CHidapiTransport::CHidapiTransport(COasisLogger &logger) : m_Logger(logger)
+{
+    m_DevHandle = nullptr;
+    m_nRepliesDue = 0;
+    m_bWake = false;
+}
+
+CHidapiTransport::~CHidapiTransport()
+{
+    close();
+}
+
+bool CHidapiTransport::open(std::string &sSerial)
+{
+    close();
+
+    if(sSerial.size()) {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "CHidapiTransport::open", "opening device with serial %s for vendor id %04X product id %04X", sSerial.c_str(), (unsigned int)VENDOR_ID, (unsigned int)PRODUCT_ID);
+        std::wstring widestr = std::wstring(sSerial.begin(), sSerial.end());
+        const wchar_t* widecstr = widestr.c_str();
+        m_DevHandle = hid_open(VENDOR_ID, PRODUCT_ID, widecstr);
+    }
+    else {
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "CHidapiTransport::open", "opening first available device for vendor id %04X product id %04X", (unsigned int)VENDOR_ID, (unsigned int)PRODUCT_ID);
+        m_DevHandle = hid_open(VENDOR_ID, PRODUCT_ID, NULL);
+    }
+
+    if (!m_DevHandle) {
+        OasisLog(m_Logger, LOG_LEVEL_ERROR, "CHidapiTransport::open", "hid_open failed for vendor id %04X product id %04X", (unsigned int)VENDOR_ID, (unsigned int)PRODUCT_ID);
+        return false;
+    }
+
+    // Set the hid_read() function to be non-blocking.
+    hid_set_nonblocking(m_DevHandle, 1);
+
+    // opened the first one available, remember which so a reconnect gets the same focuser back
+    if(!sSerial.size()) {
+        wchar_t TmpStr[128];
+        std::wstring ws;
+        if(hid_get_serial_number_string(m_DevHandle, TmpStr, sizeof(TmpStr)/sizeof(wchar_t)) >= 0) {
+            ws.assign(TmpStr);
+            sSerial.assign(ws.begin(), ws.end());
+        }
+    }
+    return true;
+}
+
+void CHidapiTransport::close()
+{
+    if(m_DevHandle) {
+        hid_close(m_DevHandle);
+        m_DevHandle = nullptr;
+    }
+    m_nRepliesDue = 0;
+}
+
+int CHidapiTransport::write(const unsigned char *cReport, int nLength)
+{
+    int nRet;
+
+    if(!m_DevHandle)
+        return -1;
+    nRet = hid_write(m_DevHandle, cReport, nLength);
+    if(nRet > 0) {
+        m_nRepliesDue++;
+        m_lastWrite = std::chrono::steady_clock::now();
+    }
+    return nRet;
+}
+
+int CHidapiTransport::read(unsigned char *cReport, int nLength, int nTimeoutMs)
+{
+    int nRet;
+
+    if(!m_DevHandle)
+        return -1;
+
+    // nothing to wait for, sleep until the caller's deadline or a wake up instead of polling hidapi.
+    if(nTimeoutMs != 0 && !isReplyDue()) {
+        std::unique_lock<std::mutex> lock(m_WakeMutex);
+        if(nTimeoutMs < 0)
+            m_WakeCond.wait(lock, [&] { return m_bWake; });
+        else
+            m_WakeCond.wait_for(lock, std::chrono::milliseconds(nTimeoutMs), [&] { return m_bWake; });
+        m_bWake = false;
+        nTimeoutMs = 0; // still pick up anything that came in meanwhile
+    }
+
+    // hidapi can't be interrupted, so never block longer than HIDAPI_READ_TIMEOUT.
+    if(nTimeoutMs < 0 || nTimeoutMs > HIDAPI_READ_TIMEOUT)
+        nTimeoutMs = HIDAPI_READ_TIMEOUT;
+    nRet = hid_read_timeout(m_DevHandle, cReport, nLength, nTimeoutMs);
+    if(nRet > 0 && m_nRepliesDue)
+        m_nRepliesDue--;
+    return nRet;
+}
+
+void CHidapiTransport::wake()
+{
+    {
+        const std::lock_guard<std::mutex> lock(m_WakeMutex);
+        m_bWake = true;
+    }
+    m_WakeCond.notify_one();
+}
+
+bool CHidapiTransport::isReplyDue() const
+{
+    // a lost reply doesn't keep us polling forever
+    return m_nRepliesDue && std::chrono::steady_clock::now() - m_lastWrite < std::chrono::milliseconds(HIDAPI_REPLY_WINDOW);
+}
+
+#ifdef SB_LINUX_BUILD
+#pragma mark - CHidrawTransport
+
+CHidrawTransport::CHidrawTransport(COasisLogger &logger) : m_Logger(logger)
+{
+    m_nHidrawFd = -1;
+    // lives as long as the transport so a wake up can't race a reopen
+    m_nWakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+CHidrawTransport::~CHidrawTransport()
+{
+    close();
+    if(m_nWakeFd >= 0) {
+        ::close(m_nWakeFd);
+        m_nWakeFd = -1;
+    }
+}
+
+bool CHidrawTransport::open(std::string &sSerial)
+{
+    DIR *dir;
+    struct dirent *entry;
+    std::ifstream ueventFile;
+    std::string sLine;
+    std::string sUniq;
+    std::string sDevPath;
+    unsigned int nBus, nVid, nPid;
+    bool bMatch;
+
+    close();
+
+    dir = opendir("/sys/class/hidraw");
+    if(!dir)
+        return false;
+
+    while((entry = readdir(dir)) != nullptr) {
+        if(strncmp(entry->d_name, "hidraw", 6))
+            continue;
+
+        // the parent hid device uevent gives us the ids and the serial (HID_UNIQ)
+        ueventFile.open(std::string("/sys/class/hidraw/") + entry->d_name + "/device/uevent");
+        if(!ueventFile.is_open())
+            continue;
+        bMatch = false;
+        sUniq.clear();
+        while(std::getline(ueventFile, sLine)) {
+            if(sLine.compare(0, 7, "HID_ID=") == 0) {
+                if(sscanf(sLine.c_str() + 7, "%x:%x:%x", &nBus, &nVid, &nPid) == 3)
+                    bMatch = (nVid == VENDOR_ID && nPid == PRODUCT_ID);
+            }
+            else if(sLine.compare(0, 9, "HID_UNIQ=") == 0) {
+                sUniq.assign(sLine.substr(9));
+            }
+        }
+        ueventFile.close();
+
+        if(!bMatch || (sSerial.size() && sUniq != sSerial))
+            continue;
+
+        sDevPath = std::string("/dev/") + entry->d_name;
+        m_nHidrawFd = ::open(sDevPath.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if(m_nHidrawFd < 0) {
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "CHidrawTransport::open", "can't open %s : %s", sDevPath.c_str(), strerror(errno));
+            continue;
+        }
+        if(!sSerial.size())
+            sSerial.assign(sUniq);
+        OasisLog(m_Logger, LOG_LEVEL_INFO, "CHidrawTransport::open", "opened %s for serial %s", sDevPath.c_str(), sSerial.c_str());
+        closedir(dir);
+        return true;
+    }
+    closedir(dir);
+    return false;
+}
+
+void CHidrawTransport::close()
+{
+    if(m_nHidrawFd >= 0) {
+        ::close(m_nHidrawFd);
+        m_nHidrawFd = -1;
+    }
+}
+
+int CHidrawTransport::write(const unsigned char *cReport, int nLength)
+{
+    struct pollfd pfd;
+    std::chrono::steady_clock::time_point deadline;
+    int nRet;
+    int nWaitMs;
+
+    if(m_nHidrawFd < 0)
+        return -1;
+
+    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(HIDRAW_WRITE_TIMEOUT);
+    while(true) {
+        // report ID 0 in the first byte is stripped by the kernel, same as hid_write.
+        nRet = (int)::write(m_nHidrawFd, cReport, nLength);
+        if(nRet >= 0)
+            return nRet;
+        if(errno == EINTR)
+            continue;
+        if(errno != EAGAIN)
+            return -1;
+
+        // the fd is non blocking for the reads, a full output queue isn't a dead link. Wait for room.
+        nWaitMs = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if(nWaitMs <= 0) {
+            OasisLog(m_Logger, LOG_LEVEL_ERROR, "CHidrawTransport::write", "output queue still full after %d ms", (int)HIDRAW_WRITE_TIMEOUT);
+            return -1;
+        }
+        pfd.fd = m_nHidrawFd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        nRet = poll(&pfd, 1, nWaitMs);
+        if(nRet < 0 && errno != EINTR)
+            return -1;
+        if(pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+            return -1;
+        poll(nullptr, 0, HIDRAW_WRITE_RETRY);
+    }
+}
+
+int CHidrawTransport::read(unsigned char *cReport, int nLength, int nTimeoutMs)
+{
+    struct pollfd pfd[2];
+    uint64_t nWakeCount;
+    int nRet;
+
+    if(m_nHidrawFd < 0)
+        return -1;
+
+    pfd[0].fd = m_nHidrawFd;
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = m_nWakeFd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+    nRet = poll(pfd, m_nWakeFd >= 0 ? 2 : 1, nTimeoutMs);
+    if(nRet == 0 || (nRet < 0 && errno == EINTR))
+        return 0;
+    if(nRet < 0 || (pfd[0].revents & (POLLERR | POLLHUP | POLLNVAL)))
+        return -1;
+    if(pfd[1].revents & POLLIN) {
+        // woken up by wake(), reset the counter and let the caller check why.
+        if(::read(m_nWakeFd, &nWakeCount, sizeof(nWakeCount)) < 0) {}
+        return 0;
+    }
+
+    nRet = (int)::read(m_nHidrawFd, cReport, nLength);
+    if(nRet < 0 && (errno == EAGAIN || errno == EINTR))
+        return 0;
+    return nRet;
+}
+
+void CHidrawTransport::wake()
+{
+    uint64_t nOne = 1;
+
+    if(m_nWakeFd >= 0) {
+        if(::write(m_nWakeFd, &nOne, sizeof(nOne)) < 0) {}
+    }
+}
+#endif
@@ -0,0 +1,106 @@
+//
+//  OasisTransport.h
+//  Oasis X2 plugin
+//
+//  Link to the focuser, one HID report at a time.
+//  COasisController only talks to a COasisTransport, the I/O thread being the only caller of open/close/read/write
+//  while it runs. wake() can come from any thread. The USB backends are hidapi (everywhere) and hidraw (Linux),
+//  COasisSimulator in OasisSimulator.h runs the firmware in process.
+
+#ifndef __OasisTransport__
+#define __OasisTransport__
+
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "hidapi.h"
+#include "OasisLogger.h"
+
+#define VENDOR_ID           0x338f
+#define PRODUCT_ID          0xa0f0
+
+#define HIDAPI_READ_TIMEOUT 10  // ms, hidapi reads can't be woken up, while a reply is due this bounds how long a queued command or a halt waits for the I/O thread
+#define HIDAPI_REPLY_WINDOW 1000 // ms, a reply that didn't come in this long after the last write is given up on, the reads go back to sleeping
+#define HIDRAW_WRITE_TIMEOUT 250 // ms, how long a write waits for room in the device output queue before the link is considered dead
+#define HIDRAW_WRITE_RETRY  1   // ms, hidraw can flag POLLOUT before the driver takes the report, never retry faster than this
+
+enum Transports     {TRANSPORT_HIDAPI = 0, TRANSPORT_HIDRAW, TRANSPORT_SIMULATOR};
+
+class COasisTransport
+{
+public:
+    virtual ~COasisTransport() {}
+
+    // sSerial selects the focuser, empty for the first one found. On success it holds the serial that was opened.
+    virtual bool        open(std::string &sSerial) = 0;
+    virtual void        close() = 0;
+    virtual bool        isOpen() const = 0;
+
+    // cReport is a whole report, report ID first. Returns the number of bytes written, -1 on error.
+    virtual int         write(const unsigned char *cReport, int nLength) = 0;
+    // the frame without the report ID. Returns the number of bytes read, 0 on timeout or wake up, -1 on error.
+    // A negative nTimeoutMs waits until there is something to read or wake() is called.
+    virtual int         read(unsigned char *cReport, int nLength, int nTimeoutMs) = 0;
+    // makes a pending or the next read return 0, for transports that can be interrupted
+    virtual void        wake() {}
+
+    virtual int         type() const = 0;
+};
+
+// hidapi reads can't be interrupted. The focuser only talks when asked, so hidapi is only polled while a reply
+// is due, the rest of the time a read sleeps on a condition variable that wake() can interrupt.
+class CHidapiTransport : public COasisTransport
+{
+public:
+    CHidapiTransport(COasisLogger &logger);
+    ~CHidapiTransport();
+
+    bool        open(std::string &sSerial) override;
+    void        close() override;
+    bool        isOpen() const override     { return m_DevHandle != nullptr; }
+    int         write(const unsigned char *cReport, int nLength) override;
+    int         read(unsigned char *cReport, int nLength, int nTimeoutMs) override;
+    void        wake() override;
+    int         type() const override       { return TRANSPORT_HIDAPI; }
+
+protected:
+    bool        isReplyDue() const;
+
+    COasisLogger        &m_Logger;
+    hid_device          *m_DevHandle;
+
+    // I/O thread only
+    int                 m_nRepliesDue;      // one report comes back for every report written
+    std::chrono::steady_clock::time_point m_lastWrite;
+
+    std::mutex          m_WakeMutex;
+    std::condition_variable m_WakeCond;
+    bool                m_bWake;
+};
+
+#ifdef SB_LINUX_BUILD
+// talks to /dev/hidrawN directly, a read can be interrupted through an eventfd
+class CHidrawTransport : public COasisTransport
+{
+public:
+    CHidrawTransport(COasisLogger &logger);
+    ~CHidrawTransport();
+
+    bool        open(std::string &sSerial) override;
+    void        close() override;
+    bool        isOpen() const override     { return m_nHidrawFd >= 0; }
+    int         write(const unsigned char *cReport, int nLength) override;
+    int         read(unsigned char *cReport, int nLength, int nTimeoutMs) override;
+    void        wake() override;
+    int         type() const override       { return TRANSPORT_HIDRAW; }
+
+protected:
+    COasisLogger        &m_Logger;
+    int                 m_nHidrawFd;
+    int                 m_nWakeFd;
+};
+#endif
+
+#endif /* __OasisTransport__ */
@@ -0,0 +1,77 @@
+//
+//  SeqLock.h
+//  Oasis X2 plugin
+//
+//  Sequence lock publishing a plain struct to any number of readers.
+//  The writer makes the sequence odd, stores the value and makes it even again, a reader retries
+//  if the sequence was odd or changed while it was copying. Readers never take a lock and never
+//  make the writer wait, they only retry when they overlap a write.
+//  The value is kept in atomic words so a torn copy is thrown away instead of being a data race.
+//  Writes must be serialized by the caller.
+
+#ifndef __SeqLock__
+#define __SeqLock__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+template <typename T>
+class CSeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value, "CSeqLock can only publish trivially copyable types");
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+public:
+    CSeqLock()
+    {
+        m_nSeq.store(0, std::memory_order_relaxed);
+        for(size_t i = 0; i < WORDS; i++)
+            m_Words[i].store(0, std::memory_order_relaxed);
+    }
+
+    void write(const T &value)
+    {
+        uint64_t buffer[WORDS] = {0};
+        uint32_t nSeq = m_nSeq.load(std::memory_order_relaxed);
+
+        memcpy(buffer, &value, sizeof(T));
+        m_nSeq.store(nSeq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for(size_t i = 0; i < WORDS; i++)
+            m_Words[i].store(buffer[i], std::memory_order_relaxed);
+        m_nSeq.store(nSeq + 2, std::memory_order_release);
+    }
+
+    // returns the version of the copy, it goes up by one on every write
+    uint32_t read(T &value) const
+    {
+        uint64_t buffer[WORDS];
+        uint32_t nSeqBefore;
+        uint32_t nSeqAfter;
+
+        do {
+            nSeqBefore = m_nSeq.load(std::memory_order_acquire);
+            for(size_t i = 0; i < WORDS; i++)
+                buffer[i] = m_Words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            nSeqAfter = m_nSeq.load(std::memory_order_relaxed);
+        } while((nSeqBefore & 1) || nSeqBefore != nSeqAfter);
+
+        memcpy(&value, buffer, sizeof(T));
+        return nSeqBefore >> 1;
+    }
+
+    uint32_t version() const
+    {
+        return m_nSeq.load(std::memory_order_acquire) >> 1;
+    }
+
+private:
+    std::atomic<uint32_t>   m_nSeq;
+    std::atomic<uint64_t>   m_Words[WORDS];
+};
+
+#endif /* __SeqLock__ */
@@ -0,0 +1,74 @@
+//
+//  SpscRing.h
+//  Oasis X2 plugin
+//
+//  Bounded lock-free single-producer / single-consumer ring.
+//  The producer only writes the tail and the consumer only writes the head, so neither side ever waits on the other.
+//  push() fails instead of blocking when the ring is full, it's up to the producer to decide what to drop.
+
+#ifndef __SpscRing__
+#define __SpscRing__
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T, size_t N>
+class CSpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "CSpscRing size must be a power of 2");
+
+public:
+    CSpscRing()
+    {
+        m_nTail.store(0, std::memory_order_relaxed);
+        m_nHead.store(0, std::memory_order_relaxed);
+    }
+
+    // producer side
+    bool push(const T &item)
+    {
+        size_t nTail = m_nTail.load(std::memory_order_relaxed);
+
+        if(nTail - m_nHead.load(std::memory_order_acquire) == N)
+            return false; // full
+        m_Slots[nTail & (N - 1)] = item;
+        m_nTail.store(nTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side
+    bool pop(T &item)
+    {
+        size_t nHead = m_nHead.load(std::memory_order_relaxed);
+
+        if(nHead == m_nTail.load(std::memory_order_acquire))
+            return false; // empty
+        item = m_Slots[nHead & (N - 1)];
+        m_nHead.store(nHead + 1, std::memory_order_release);
+        return true;
+    }
+
+    // only the consumer may call clear(), and only while the producer isn't pushing
+    void clear()
+    {
+        m_nHead.store(m_nTail.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // safe from any thread, but only a snapshot
+    size_t size() const
+    {
+        size_t nTail = m_nTail.load(std::memory_order_acquire);
+        size_t nHead = m_nHead.load(std::memory_order_acquire);
+        return nTail - nHead;
+    }
+
+    size_t capacity() const { return N; }
+
+private:
+    T                               m_Slots[N];
+    // keep the producer and consumer indexes on their own cache lines
+    alignas(64) std::atomic<size_t> m_nTail;
+    alignas(64) std::atomic<size_t> m_nHead;
+};
+
+#endif /* __SpscRing__ */
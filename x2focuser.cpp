@@ -13,7 +13,7 @@ X2Focuser::X2Focuser(const char* pszDisplayName,
 
 {
     char szFocuserSerial[128];
-    int nErr = SB_OK;
+    char szFaultSpec[256];
 
     m_nPrivateMulitInstanceIndex    = nInstanceIndex;
 	m_pTheSkyXForMounts				= pTheSkyXIn;
@@ -25,30 +25,50 @@ X2Focuser::X2Focuser(const char* pszDisplayName,
 
 	m_bLinked = false;
 	m_nPosition = 0;
+    m_bSettingsLocked = false;
     m_sFocuserSerial.clear();
     // Read in settings
 
 
     // Read in settings
     if (m_pIniUtil) {
+        // 0 = hidapi, 1 = hidraw (Linux only, falls back to hidapi if the node can't be opened), 2 = simulated focuser
+        m_OasisController.setTransport(m_pIniUtil->readInt(KEY_X2FOC_ROOT, TRANSPORT, TRANSPORT_HIDRAW));
+        // 1 = the simulated focuser has its external temperature probe plugged in
+        m_OasisController.setSimulatorProbe(m_pIniUtil->readInt(KEY_X2FOC_ROOT, SIMULATOR_PROBE, 0) != 0);
+        // link fault injection for resilience testing, off when empty. See COasisFaultTransport::parseProfile
+        m_pIniUtil->readString(KEY_X2FOC_ROOT, FAULT_INJECTION, "", szFaultSpec, 256);
+        m_OasisController.setFaultInjection(szFaultSpec);
+        // ms without a status reply before the plugin reopens the focuser
+        m_OasisController.setStallTimeout(m_pIniUtil->readInt(KEY_X2FOC_ROOT, STALL_TIMEOUT, LINK_STALL_TIMEOUT));
+        // 0 = off, 1 = errors, 2 = info, 3 = every frame. Written to Oasis-Log.txt in the home folder
+        m_OasisController.setLogLevel(m_pIniUtil->readInt(KEY_X2FOC_ROOT, LOGGING_LEVEL, LOG_DEFAULT_LEVEL));
+        // 1 = record every HID report to Oasis-Trace-<serial>.bin in the home folder while connected, see OasisReplay.
+        // the previous connection's trace is kept as Oasis-Trace-<serial>.prev.bin
+        m_OasisController.setFrameTrace(m_pIniUtil->readInt(KEY_X2FOC_ROOT, FRAME_TRACE, 0) != 0);
         m_pIniUtil->readString(KEY_X2FOC_ROOT, KEY_SN, "0", szFocuserSerial, 128);
         m_sFocuserSerial.assign(szFocuserSerial);
-        if(m_OasisController.isFocuserPresent(m_sFocuserSerial)) {
-            m_OasisController.setFocuserSerial(m_sFocuserSerial);
-        }
-        else
-            m_sFocuserSerial.clear();
-        nErr = loadFocuserSettings(m_sFocuserSerial);
     }
 
-
-    if (m_pIniUtil) {
-        m_OasisController.setTemperatureSource(m_pIniUtil->readInt(m_sFocuserSerial.c_str(), TEMP_SOURCE, INTERNAL));
-    }
+    // enumerating the USB bus is slow, don't make TheSkyX wait for it while loading plugins.
+    // The saved serial is checked against the result the first time we actually need it.
+    m_bEnumerationDone = false;
+    m_EnumerationFuture = std::async(std::launch::async, [this]() {
+        std::vector<std::string> focuserSNList;
+        m_OasisController.listFocusers(focuserSNList);
+        return focuserSNList;
+    });
 }
 
 X2Focuser::~X2Focuser()
 {
+    // the enumeration task uses m_OasisController, make sure it's done before anything goes away.
+    if(m_EnumerationFuture.valid())
+        m_EnumerationFuture.wait();
+    // same for a settings apply still running
+    if(m_ApplyFuture.valid())
+        m_ApplyFuture.wait();
+
     //Delete objects used through composition
 	if (GetTheSkyXFacadeForDrivers())
 		delete GetTheSkyXFacadeForDrivers();
@@ -150,6 +170,8 @@ int	X2Focuser::establishLink(void)
     int nErr;
 
     X2MutexLocker ml(GetMutex());
+    waitForEnumeration();
+    loadDeviceCache(m_sFocuserSerial);
     // get serial port device name
     nErr = m_OasisController.Connect();
     if(nErr)
@@ -167,6 +189,9 @@ int	X2Focuser::terminateLink(void)
         return SB_OK;
 
     X2MutexLocker ml(GetMutex());
+    // let a settings apply finish before the link goes away, it saves the device cache
+    collectApply(true);
+    saveDeviceCache(m_sFocuserSerial);
     m_OasisController.Disconnect();
     m_bLinked = false;
 
@@ -193,6 +218,8 @@ int	X2Focuser::execModalSettingsDialog(void)
     bool bFocFound = false;
     int nFocIndex = 0;
     int i;
+
+    waitForEnumeration();
     if(m_bLinked) {
         m_nCurrentDialog = SETTINGS;
 
@@ -265,6 +292,7 @@ void X2Focuser::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
 {
     std::stringstream sTmpBuf;
     int nTmp;
+    Oasis_State state;
 
     switch(m_nCurrentDialog) {
         case  SELECT:
@@ -272,22 +300,44 @@ void X2Focuser::uiEvent(X2GUIExchangeInterface* uiex, const char* pszEvent)
         case SETTINGS:
             if (!strcmp(pszEvent, "on_timer")) {
                 if(m_bLinked) {
-                    sTmpBuf << std::fixed << std::setprecision(2) << m_OasisController.getTemperature(INTERNAL) << " ºC";
+                    // both temperatures and the probe presence from the same status
+                    m_OasisController.getState(state);
+                    sTmpBuf << std::fixed << std::setprecision(2) << state.fInternal << " ºC";
                     uiex->setText("focuserTemp", sTmpBuf.str().c_str());
-                    if(m_OasisController.isExternalSensorPresent()) {
+                    if(state.bExternalSensorPresent) {
                         std::stringstream().swap(sTmpBuf);
-                        sTmpBuf << std::fixed << std::setprecision(2) << m_OasisController.getTemperature(EXTERNAL) << " ºC";
+                        sTmpBuf << std::fixed << std::setprecision(2) << state.fAmbient << " ºC";
                         uiex->setText("probeTemp", sTmpBuf.str().c_str());
                     }
+                    // a previous apply was still running when the dialog opened, unlock the controls once it's done
+                    if(m_bSettingsLocked && !isApplyRunning()) {
+                        collectApply(false);
+                        loadSettingsControls(uiex);
+                        enableSettingsControls(uiex, true);
+                        m_bSettingsLocked = false;
+                    }
+                    // the names asked for when the dialog opened
+                    if(!m_bSettingsLocked) {
+                        updateNameControl(uiex, "bluetoothName", state.sBluetoothName.c_str(), m_sShownBluetoothName);
+                        updateNameControl(uiex, "friendlyName", state.sFriendlyName.c_str(), m_sShownFriendlyName);
+                    }
                 }
+                uiex->setText("applyStatus", getApplyStatus().c_str());
             }
             else if (!strcmp(pszEvent, "on_pushButton_2_clicked")) {
                 uiex->propertyInt("newPos", "value", nTmp);
+                // a sync while TheSkyX is starting a move would race it, same lock as the focuser calls
+                X2MutexLocker ml(GetMutex());
                 m_OasisController.setPosition((unsigned int)nTmp);
             }
             else if (!strcmp(pszEvent, "on_pushButton_3_clicked")) {
+                if(m_bSettingsLocked || isApplyRunning())
+                    break;
+                COasisConfigTransaction config;
                 uiex->propertyInt("posLimit", "value", nTmp);
-                m_OasisController.setMaxStep((unsigned int)nTmp);
+                config.setMaxStep((uint32_t)nTmp);
+                startApply(config);
+                uiex->setText("applyStatus", getApplyStatus().c_str());
             }
             break;
         default:
@@ -305,9 +355,9 @@ int X2Focuser::doOasisFocuserFeatureConfig()
     bool bPressedOK = false;
     std::stringstream sTmpBuf;
     int nTmp;
-    std::string sFriendlyName;
-    std::string sBluetoothName;
     char szTmpBuf[FRAME_NAME_LEN+1];
+    COasisConfigTransaction config;
+    Oasis_State state;
 
     mUiEnabled = false;
 
@@ -320,42 +370,42 @@ int X2Focuser::doOasisFocuserFeatureConfig()
     if (NULL == (dx = uiutil.X2DX()))
         return ERR_POINTER;
 
-    X2MutexLocker ml(GetMutex());
+    // No X2 mutex here, the controller serializes device access on its own and
+    // holding it while the dialog is up or the settings are written would stall focuser polling.
+    collectApply(false);
+    m_bSettingsLocked = false;
 
     // set controls values
     if(m_bLinked) {
-        if(m_OasisController.isExternalSensorPresent()) {
+        m_OasisController.getState(state);
+        if(state.bExternalSensorPresent) {
             dx->comboBoxAppendString("comboBox", "Internal");
             dx->comboBoxAppendString("comboBox", "External");
             nTmp = m_OasisController.getTemperatureSource();
             dx->setCurrentIndex("comboBox", nTmp==INTERNAL?0:1);
-            sTmpBuf << std::fixed << std::setprecision(2) << m_OasisController.getTemperature(INTERNAL) << " ºC";
+            sTmpBuf << std::fixed << std::setprecision(2) << state.fInternal << " ºC";
             dx->setText("internalTemp", sTmpBuf.str().c_str());
 
             std::stringstream().swap(sTmpBuf);
-            sTmpBuf << std::fixed << std::setprecision(2) << m_OasisController.getTemperature(EXTERNAL) << " ºC";
+            sTmpBuf << std::fixed << std::setprecision(2) << state.fAmbient << " ºC";
             dx->setText("probeTemp", sTmpBuf.str().c_str());
         }
         else {
             dx->comboBoxAppendString("comboBox", "Internal");
             dx->setCurrentIndex("comboBox", 0);
-            sTmpBuf << std::fixed << std::setprecision(2) << m_OasisController.getTemperature(INTERNAL) << " ºC";
+            sTmpBuf << std::fixed << std::setprecision(2) << state.fInternal << " ºC";
             dx->setText("internalTemp", sTmpBuf.str().c_str());
             dx->setText("probeTemp", "Not present");
             dx->setEnabled("comboBox", false);
         }
-        dx->setPropertyInt("newPos", "value", m_OasisController.getPosition());
-        dx->setPropertyInt("posLimit", "value", m_OasisController.getPosLimit());
-        dx->setChecked("reverseDir", m_OasisController.getReverse());
-        dx->setPropertyInt("backlashSteps", "value", m_OasisController.getBacklash());
-        dx->setChecked("radioButton", m_OasisController.getBacklashDirection() == 0?true:false);
-        dx->setChecked("beepOnConnect", m_OasisController.getBeepOnStartup()?1:0);
-        dx->setChecked("beepOnMove", m_OasisController.getBeepOnMove()?1:0);
-        dx->setChecked("bluetoothEnable", m_OasisController.getBluetoothEnabled()?1:0);
-        m_OasisController.getBluetoothName(sBluetoothName);
-        dx->setText("bluetoothName", sBluetoothName.c_str());
-        m_OasisController.getFriendlyName(sFriendlyName);
-        dx->setText("friendlyName", sFriendlyName.c_str());
+        dx->setPropertyInt("newPos", "value", state.nCurPos);
+        loadSettingsControls(dx);
+        // the names are shown from the state as they are, the fresh ones come in on the timer
+        m_OasisController.refreshDeviceNames();
+        // the previous settings are still being written, don't let them be edited until that's done
+        m_bSettingsLocked = isApplyRunning();
+        if(m_bSettingsLocked)
+            enableSettingsControls(dx, false);
     }
     else {
         dx->setEnabled("comboBox", false);
@@ -373,6 +423,7 @@ int X2Focuser::doOasisFocuserFeatureConfig()
         dx->setEnabled("bluetoothName", false);
         dx->setEnabled("friendlyName", false);
     }
+    dx->setText("applyStatus", getApplyStatus().c_str());
 
     //Display the user interface
     mUiEnabled = true;
@@ -386,55 +437,205 @@ int X2Focuser::doOasisFocuserFeatureConfig()
         m_OasisController.setTemperatureSource(nTmp==0?INTERNAL:EXTERNAL);
         m_pIniUtil->writeInt(m_sFocuserSerial.c_str(), TEMP_SOURCE, nTmp==0?INTERNAL:EXTERNAL);
 
-        nErr = m_OasisController.setReverse(dx->isChecked("reverseDir")==1);
-        if(nErr) // retry
-            nErr = m_OasisController.setReverse(dx->isChecked("reverseDir")==1);
+        // the controls were locked, they still show the values that are being written
+        if(!m_bLinked || m_bSettingsLocked) {
+            m_bSettingsLocked = false;
+            return SB_OK;
+        }
+
+        // everything goes out as one config frame, only what changed is sent and it's read back once
+        config.setReverse(dx->isChecked("reverseDir")==1);
         dx->propertyInt("backlashSteps", "value", nTmp);
+        config.setBacklash(nTmp);
+        config.setBacklashDirection( dx->isChecked("radioButton")==1?0:1 );
+        config.setBeepOnStartup( dx->isChecked("beepOnConnect")==1?true:false );
+        config.setBeepOnMove( dx->isChecked("beepOnMove")==1?true:false );
+        config.setBluetoothEnabled( dx->isChecked("bluetoothEnable")==1?true:false );
 
-        nErr = m_OasisController.setBacklash(nTmp);
-        if(nErr) // retry
-            nErr = m_OasisController.setBacklash(nTmp);
+        // names only when edited, a name that wasn't read yet shows empty and mustn't be written back
+        memset(szTmpBuf,0,FRAME_NAME_LEN+1);
+        dx->propertyString("bluetoothName", "text", szTmpBuf, FRAME_NAME_LEN);
+        if(m_sShownBluetoothName != szTmpBuf)
+            config.setBluetoothName(std::string(szTmpBuf));
 
-        nErr = m_OasisController.setBacklashDirection( dx->isChecked("radioButton")==1?0:1 );
-        if(nErr) // retry
-            nErr = m_OasisController.setBacklashDirection( dx->isChecked("radioButton")==1?0:1 );
+        memset(szTmpBuf,0,FRAME_NAME_LEN+1);
+        dx->propertyString("friendlyName", "text", szTmpBuf, FRAME_NAME_LEN);
+        if(m_sShownFriendlyName != szTmpBuf)
+            config.setFriendlyName(std::string(szTmpBuf));
 
-        nErr = m_OasisController.setBeepOnStartup( dx->isChecked("beepOnConnect")==1?true:false );
-        if(nErr) // retry
-            nErr = m_OasisController.setBeepOnStartup( dx->isChecked("beepOnConnect")==1?true:false );
+        // written in the background, the dialog returns right away
+        startApply(config);
+    }
+    m_bSettingsLocked = false;
+    return nErr;
+}
 
-        nErr = m_OasisController.setBeepOnStartup( dx->isChecked("beepOnConnect")==1?true:false );
-        if(nErr) // retry
-            nErr = m_OasisController.setBeepOnStartup( dx->isChecked("beepOnConnect")==1?true:false );
+void X2Focuser::loadSettingsControls(X2GUIExchangeInterface* dx)
+{
+    Oasis_State state;
+
+    // one snapshot for all the fields, a config reply landing in between can't mix old and new values.
+    m_OasisController.getState(state);
+    dx->setPropertyInt("posLimit", "value", state.nMaxPos);
+    dx->setChecked("reverseDir", state.bIsReversed);
+    dx->setPropertyInt("backlashSteps", "value", state.backlash);
+    dx->setChecked("radioButton", state.backlashDirection == 0?true:false);
+    dx->setChecked("radioButton_2", state.backlashDirection == 0?false:true);
+    dx->setChecked("beepOnConnect", state.beepOnStartup==1?1:0);
+    dx->setChecked("beepOnMove", state.beepOnMove==1?1:0);
+    dx->setChecked("bluetoothEnable", state.bluetoothOn==1?1:0);
+    // from the snapshot too, the name getters would wait on the device with the UI thread
+    m_sShownBluetoothName.assign(state.sBluetoothName.c_str());
+    dx->setText("bluetoothName", m_sShownBluetoothName.c_str());
+    m_sShownFriendlyName.assign(state.sFriendlyName.c_str());
+    dx->setText("friendlyName", m_sShownFriendlyName.c_str());
+}
 
-        nErr = m_OasisController.setBeepOnMove( dx->isChecked("beepOnMove")==1?true:false );
-        if(nErr) // retry
-            nErr = m_OasisController.setBeepOnMove( dx->isChecked("beepOnMove")==1?true:false );
+void X2Focuser::updateNameControl(X2GUIExchangeInterface* dx, const char *szControl, const char *szName, std::string &sShown)
+{
+    char szTmpBuf[FRAME_NAME_LEN+1];
 
-        nErr = m_OasisController.setBluetoothEnabled( dx->isChecked("bluetoothEnable")==1?true:false );
-        if(nErr) // retry
-            nErr = m_OasisController.setBluetoothEnabled( dx->isChecked("bluetoothEnable")==1?true:false );
+    if(sShown == szName)
+        return;
+    memset(szTmpBuf,0,FRAME_NAME_LEN+1);
+    dx->propertyString(szControl, "text", szTmpBuf, FRAME_NAME_LEN);
+    if(sShown != szTmpBuf)
+        return; // being edited, leave it alone
+    sShown.assign(szName);
+    dx->setText(szControl, sShown.c_str());
+}
 
-        memset(szTmpBuf,0,FRAME_NAME_LEN+1);
-        dx->propertyString("bluetoothName", "text", szTmpBuf, FRAME_NAME_LEN);
-        nErr = m_OasisController.setBluetoothName(std::string(szTmpBuf));
-        if(nErr) // retry
-            nErr = m_OasisController.setBluetoothName(std::string(szTmpBuf));
+void X2Focuser::enableSettingsControls(X2GUIExchangeInterface* dx, bool bEnable)
+{
+    dx->setEnabled("posLimit", bEnable);
+    dx->setEnabled("pushButton_3", bEnable);
+    dx->setEnabled("reverseDir", bEnable);
+    dx->setEnabled("backlashSteps", bEnable);
+    dx->setEnabled("radioButton", bEnable);
+    dx->setEnabled("radioButton_2", bEnable);
+    dx->setEnabled("beepOnConnect", bEnable);
+    dx->setEnabled("beepOnMove", bEnable);
+    dx->setEnabled("bluetoothEnable", bEnable);
+    dx->setEnabled("bluetoothName", bEnable);
+    dx->setEnabled("friendlyName", bEnable);
+}
 
-        memset(szTmpBuf,0,FRAME_NAME_LEN+1);
-        dx->propertyString("friendlyName", "text", szTmpBuf, FRAME_NAME_LEN);
-        nErr = m_OasisController.setFriendlyName(std::string(szTmpBuf));
-        if(nErr) // retry
-            nErr = m_OasisController.setBluetoothName(std::string(szTmpBuf));
-
-        nErr = m_OasisController.getConfig();
-        nErr = m_OasisController.getBluetoothName();
-        nErr = m_OasisController.getFriendlyName();
-        nErr = SB_OK;
+#pragma mark - background settings apply
+
+// names used to report what happened to each config field
+static const struct {
+    uint32_t    nMask;
+    const char  *szName;
+} ConfigFieldNames[] = {
+    {MASK_MAX_STEP,             "Max step"},
+    {MASK_BACKLASH,             "Backlash"},
+    {MASK_BACKLASH_DIRECTION,   "Backlash direction"},
+    {MASK_REVERSE_DIRECTION,    "Reverse"},
+    {MASK_SPEED,                "Speed"},
+    {MASK_BEEP_ON_MOVE,         "Beep on move"},
+    {MASK_BEEP_ON_STARTUP,      "Beep on startup"},
+    {MASK_BLUETOOTH,            "Bluetooth"},
+};
+
+void X2Focuser::startApply(const COasisConfigTransaction &config)
+{
+    // only one apply at a time, the controls are locked while one runs so this shouldn't wait
+    collectApply(true);
+
+    setApplyStatus("Applying settings...");
+    m_ApplyFuture = std::async(std::launch::async, [this, config]() {
+        return applySettings(config);
+    });
+}
+
+int X2Focuser::applySettings(COasisConfigTransaction config)
+{
+    int nErr;
+    uint32_t nSentMask;
+    bool bBluetoothNameSent;
+    bool bFriendlyNameSent;
+    std::stringstream ssStatus;
+    std::stringstream ssFailed;
+    std::string sField;
+
+    nErr = m_OasisController.commitConfig(config);
+    nSentMask = config.nSentMask;
+    bBluetoothNameSent = config.bSetBluetoothName;
+    bFriendlyNameSent = config.bSetFriendlyName;
+    if(nErr) { // retry, what went through the first time is elided now
+        nErr = m_OasisController.commitConfig(config);
+        nSentMask |= config.nSentMask;
+    }
+    // the last pass says what's still not right
+
+    for(auto &field : ConfigFieldNames) {
+        if(!(config.nMask & field.nMask))
+            continue;
+        if(config.nFailedMask & field.nMask)
+            sField = "failed";
+        else if(nSentMask & field.nMask)
+            sField = "ok";
+        else
+            sField = "unchanged";
+        if(sField == "failed")
+            ssFailed << (ssFailed.str().size()?", ":"") << field.szName;
+        ssStatus << "Oasis: " << field.szName << " " << sField << "\n";
+    }
+    bBluetoothNameSent |= config.bSetBluetoothName;
+    bFriendlyNameSent |= config.bSetFriendlyName;
+    if(bBluetoothNameSent || config.nBluetoothNameErr) {
+        ssStatus << "Oasis: Bluetooth name " << (config.nBluetoothNameErr?"failed":"ok") << "\n";
+        if(config.nBluetoothNameErr)
+            ssFailed << (ssFailed.str().size()?", ":"") << "Bluetooth name";
     }
+    if(bFriendlyNameSent || config.nFriendlyNameErr) {
+        ssStatus << "Oasis: Friendly name " << (config.nFriendlyNameErr?"failed":"ok") << "\n";
+        if(config.nFriendlyNameErr)
+            ssFailed << (ssFailed.str().size()?", ":"") << "Friendly name";
+    }
+
+    if(m_pLogger && ssStatus.str().size())
+        m_pLogger->out(ssStatus.str().c_str());
+
+    if(!nErr)
+        setApplyStatus("Settings applied");
+    else if(ssFailed.str().size())
+        setApplyStatus("Failed to apply : " + ssFailed.str());
+    else
+        setApplyStatus("Failed to apply settings, error " + std::to_string(nErr));
+
     return nErr;
 }
 
+bool X2Focuser::isApplyRunning()
+{
+    return m_ApplyFuture.valid() && m_ApplyFuture.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+void X2Focuser::collectApply(bool bWait)
+{
+    if(!m_ApplyFuture.valid())
+        return;
+    if(!bWait && isApplyRunning())
+        return;
+
+    m_ApplyFuture.get();
+    // the worker doesn't touch the ini file, store what the focuser confirmed from here
+    saveDeviceCache(m_sFocuserSerial);
+}
+
+void X2Focuser::setApplyStatus(const std::string &sStatus)
+{
+    const std::lock_guard<std::mutex> lock(m_ApplyMutex);
+    m_sApplyStatus.assign(sStatus);
+}
+
+std::string X2Focuser::getApplyStatus()
+{
+    const std::lock_guard<std::mutex> lock(m_ApplyMutex);
+    return m_sApplyStatus;
+}
+
 int X2Focuser::loadFocuserSettings(std::string sSerial)
 {
     int nErr = PLUGIN_OK;
@@ -457,6 +658,94 @@ int X2Focuser::loadFocuserSettings(std::string sSerial)
     return nErr;
 }
 
+void X2Focuser::waitForEnumeration()
+{
+    std::vector<std::string> focuserSNList;
+    bool bFound = false;
+
+    if(m_bEnumerationDone)
+        return;
+    m_bEnumerationDone = true;
+
+    if(m_EnumerationFuture.valid())
+        focuserSNList = m_EnumerationFuture.get();
+
+    for (std::string serial : focuserSNList) {
+        if(m_sFocuserSerial == serial) {
+            bFound = true;
+            break;
+        }
+    }
+    if(bFound)
+        m_OasisController.setFocuserSerial(m_sFocuserSerial);
+    else
+        m_sFocuserSerial.clear();
+
+    if (m_pIniUtil) {
+        loadFocuserSettings(m_sFocuserSerial);
+        m_OasisController.setTemperatureSource(m_pIniUtil->readInt(m_sFocuserSerial.c_str(), TEMP_SOURCE, INTERNAL));
+    }
+}
+
+void X2Focuser::loadDeviceCache(std::string sSerial)
+{
+    char szTmpBuf[TMP_BUF_SIZE];
+    Oasis_Device_Cache cache;
+
+    if(!m_pIniUtil || !sSerial.size())
+        return;
+
+    m_pIniUtil->readString(sSerial.c_str(), CACHED_FIRMWARE, "", szTmpBuf, TMP_BUF_SIZE);
+    if(!strlen(szTmpBuf)) { // nothing cached yet, cold connect
+        m_OasisController.clearDeviceCache();
+        return;
+    }
+    cache.sVersion.assign(szTmpBuf);
+    m_pIniUtil->readString(sSerial.c_str(), CACHED_MODEL, "", szTmpBuf, TMP_BUF_SIZE);
+    cache.sModel.assign(szTmpBuf);
+    m_pIniUtil->readString(sSerial.c_str(), CACHED_BT_NAME, "", szTmpBuf, TMP_BUF_SIZE);
+    cache.sBluetoothName.assign(szTmpBuf);
+    m_pIniUtil->readString(sSerial.c_str(), CACHED_FRIENDLY, "", szTmpBuf, TMP_BUF_SIZE);
+    cache.sFriendlyName.assign(szTmpBuf);
+
+    cache.nMaxPos = (uint32_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_MAX_POS, 0);
+    cache.backlash = (uint32_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_BACKLASH, 0);
+    cache.backlashDirection = (uint8_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_BACKLASH_DIR, 0);
+    cache.bIsReversed = m_pIniUtil->readInt(sSerial.c_str(), CACHED_REVERSED, 0) != 0;
+    cache.speed = (uint8_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_SPEED, 0);
+    cache.beepOnMove = (uint8_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_BEEP_MOVE, 0);
+    cache.beepOnStartup = (uint8_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_BEEP_START, 0);
+    cache.bluetoothOn = (uint8_t)m_pIniUtil->readInt(sSerial.c_str(), CACHED_BT_ON, 0);
+
+    m_OasisController.setDeviceCache(cache);
+}
+
+void X2Focuser::saveDeviceCache(std::string sSerial)
+{
+    Oasis_Device_Cache cache;
+
+    if(!m_pIniUtil || !sSerial.size())
+        return;
+
+    // only store what the focuser confirmed during this link
+    if(!m_OasisController.getDeviceCache(cache))
+        return;
+
+    m_pIniUtil->writeString(sSerial.c_str(), CACHED_FIRMWARE, cache.sVersion.c_str());
+    m_pIniUtil->writeString(sSerial.c_str(), CACHED_MODEL, cache.sModel.c_str());
+    m_pIniUtil->writeString(sSerial.c_str(), CACHED_BT_NAME, cache.sBluetoothName.c_str());
+    m_pIniUtil->writeString(sSerial.c_str(), CACHED_FRIENDLY, cache.sFriendlyName.c_str());
+
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_MAX_POS, (int)cache.nMaxPos);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_BACKLASH, (int)cache.backlash);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_BACKLASH_DIR, cache.backlashDirection);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_REVERSED, cache.bIsReversed?1:0);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_SPEED, cache.speed);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_BEEP_MOVE, cache.beepOnMove);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_BEEP_START, cache.beepOnStartup);
+    m_pIniUtil->writeInt(sSerial.c_str(), CACHED_BT_ON, cache.bluetoothOn);
+}
+
 #pragma mark - FocuserGotoInterface2
 int	X2Focuser::focPosition(int& nPosition)
 {
@@ -39,6 +39,25 @@ class TickCountInterface;
 #define AUTOFAN_STATE       "AutoFan"
 #define LAST_POSITION       "LastPosition"
 #define RESTORE_POSITION    "RestorePosition"
+#define TRANSPORT           "Transport"
+#define STALL_TIMEOUT       "StallTimeout"
+#define LOGGING_LEVEL       "LogLevel"
+#define FRAME_TRACE         "FrameTrace"
+#define SIMULATOR_PROBE     "SimulatorProbe"
+#define FAULT_INJECTION     "FaultInjection"
+// device info cached per serial number to speed up reconnects
+#define CACHED_FIRMWARE     "CachedFirmware"
+#define CACHED_MODEL        "CachedModel"
+#define CACHED_BT_NAME      "CachedBluetoothName"
+#define CACHED_FRIENDLY     "CachedFriendlyName"
+#define CACHED_MAX_POS      "CachedMaxPos"
+#define CACHED_BACKLASH     "CachedBacklash"
+#define CACHED_BACKLASH_DIR "CachedBacklashDirection"
+#define CACHED_REVERSED     "CachedReversed"
+#define CACHED_SPEED        "CachedSpeed"
+#define CACHED_BEEP_MOVE    "CachedBeepOnMove"
+#define CACHED_BEEP_START   "CachedBeepOnStartup"
+#define CACHED_BT_ON        "CachedBluetoothOn"
 
 #define LOG_BUFFER_SIZE 256
 #define TMP_BUF_SIZE    1024
@@ -129,6 +148,18 @@ private:
 
     int                                     doOasisFocuserFeatureConfig();
     int                                     loadFocuserSettings(std::string sSerial);
+    void                                    waitForEnumeration();
+    void                                    loadDeviceCache(std::string sSerial);
+    void                                    saveDeviceCache(std::string sSerial);
+    void                                    startApply(const COasisConfigTransaction &config);
+    int                                     applySettings(COasisConfigTransaction config);
+    bool                                    isApplyRunning();
+    void                                    collectApply(bool bWait);
+    void                                    setApplyStatus(const std::string &sStatus);
+    std::string                             getApplyStatus();
+    void                                    loadSettingsControls(X2GUIExchangeInterface* dx);
+    void                                    enableSettingsControls(X2GUIExchangeInterface* dx, bool bEnable);
+    void                                    updateNameControl(X2GUIExchangeInterface* dx, const char *szControl, const char *szName, std::string &sShown);
 
     int                                     m_nPrivateMulitInstanceIndex;
 
@@ -153,6 +184,19 @@ private:
 	int                 m_nPosition;
     COasisController    m_OasisController;
     bool                mUiEnabled;
+
+    // background USB enumeration started at construction, see waitForEnumeration
+    std::future<std::vector<std::string>>   m_EnumerationFuture;
+    bool                m_bEnumerationDone;
+
+    // settings from the dialog are written by a background worker, see startApply
+    std::future<int>    m_ApplyFuture;
+    std::mutex          m_ApplyMutex;
+    std::string         m_sApplyStatus;
+    bool                m_bSettingsLocked;
+    // names shown in the settings dialog, updated by on_timer as long as the user didn't edit them
+    std::string         m_sShownBluetoothName;
+    std::string         m_sShownFriendlyName;
 };
 
 